@@ -0,0 +1,222 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), ldexp()
+#include <stdlib.h> // rand(), srand(), atoi()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 5
+#define TILE 32
+#define PASSES 8                // Each pass renders N / PASSES samples of every pixel
+#define FIXED_BITS 19           // Fractional bits of the 32-bit fixed-point accumulator
+#define MAX_RADIANCE 16.0f      // Clamp of a sample, N * MAX_RADIANCE * 2^FIXED_BITS must fit 32 bits
+#define KAHAN 0                 // Compensated float sums instead of fixed point
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+
+unsigned char img[W * H * 3];
+#if KAHAN
+float accum[W * H * 3], compensation[W * H * 3];
+#else
+unsigned accum[W * H * 3];
+#endif
+int order[PASSES * (W / TILE) * (H / TILE)];
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, -0.2f, 0.1f), 0.0f, 0.0f, { 10.0f, 10.0f, 10.0f }, BLACK };
+    Result b = {   ngonSDF(x, y, 0.5f, 0.5f, 0.25f, 5.0f), 0.0f, 1.5f, BLACK, { 4.0f, 4.0f, 1.0f} };
+    return unionOp(a, b);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            Color sum = r.emissive;
+            if (depth < MAX_DEPTH && r.eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            return colorMultiply(sum, beerLambert(r.absorption, t));
+        }
+        t += r.sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+// Stateless random number in [0, 1) of sample i of a pixel, so the jitter
+// does not depend on the order in which pixels and passes are rendered
+float jitter(unsigned pixel, unsigned i) {
+    unsigned h = pixel * 0x9e3779b9u ^ i * 0x85ebca6bu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// Integer sums are associative, so the result is exact and independent of
+// the order in which passes and tiles are added. Each sample is clamped so
+// that N of them cannot overflow. The emitter of the scene is 10, so the
+// clamp never changes a sample, and 2^-FIXED_BITS is far below 8-bit output.
+void accumulate(int i, float c) {
+    c = fminf(fmaxf(c, 0.0f), MAX_RADIANCE);
+#if KAHAN
+    float y = c - compensation[i], t = accum[i] + y;
+    compensation[i] = (t - accum[i]) - y;
+    accum[i] = t;
+#else
+    accum[i] += (unsigned)(c * (1 << FIXED_BITS) + 0.5f);
+#endif
+}
+
+float average(int i) {
+#if KAHAN
+    return accum[i] / N;
+#else
+    return (float)ldexp((double)accum[i], -FIXED_BITS) / N;
+#endif
+}
+
+// Samples [pass * N / PASSES, (pass + 1) * N / PASSES) of the pixels in a tile
+void render(int pass, int tx, int ty) {
+    for (int y = ty * TILE; y < (ty + 1) * TILE; y++)
+        for (int x = tx * TILE; x < (tx + 1) * TILE; x++)
+            for (int i = pass * N / PASSES; i < (pass + 1) * N / PASSES; i++) {
+                float a = TWO_PI * (i + jitter(y * W + x, i)) / N;
+                Color c = trace((float)x / W, (float)y / H, cosf(a), sinf(a), 0);
+                accumulate((y * W + x) * 3 + 0, c.r);
+                accumulate((y * W + x) * 3 + 1, c.g);
+                accumulate((y * W + x) * 3 + 2, c.b);
+            }
+}
+
+// Render the work items of all passes and tiles in an order shuffled by the
+// seed (e.g. ./accumulation 7). The checksum of the accumulator is the same
+// for every seed, while compensated float sums only come close.
+int main(int argc, char* argv[]) {
+    int count = sizeof(order) / sizeof(order[0]);
+    unsigned long long checksum = 14695981039346656037ull;
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    for (int k = 0; k < count; k++)
+        order[k] = k;
+    for (int k = count - 1; k > 0; k--) {
+        int j = rand() % (k + 1), t = order[k];
+        order[k] = order[j];
+        order[j] = t;
+    }
+    for (int k = 0; k < count; k++) {
+        int tile = order[k] % ((W / TILE) * (H / TILE));
+        render(order[k] / ((W / TILE) * (H / TILE)), tile % (W / TILE), tile / (W / TILE));
+    }
+
+    const unsigned char* q = (const unsigned char*)accum;
+    for (size_t k = 0; k < sizeof(accum); k++)
+        checksum = (checksum ^ q[k]) * 1099511628211ull;
+    printf("checksum %016llx\n", checksum);
+
+    // Bytes of the accumulator read and written by every sample, against
+    // 12 for the naive float sums of the other samples
+    printf("accumulator %d bytes per pixel\n", (int)(sizeof(accum) * (KAHAN ? 2 : 1) / (W * H)));
+
+    for (int i = 0; i < W * H * 3; i++)
+        img[i] = (int)(fminf(average(i) * 255.0f, 255.0f));
+    svpng(fopen("accumulation.png", "wb"), W, H, img, 0);
+}
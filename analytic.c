@@ -0,0 +1,305 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 2.0f
+#define EPSILON 1e-6f
+#define INF 1e30f
+#define MAX_SPAN 8
+
+typedef struct { float sd, emissive; } Result;
+typedef struct { float t0, t1, emissive; } Span;
+typedef struct { int n; Span s[MAX_SPAN]; } Spans; // Sorted and disjoint intervals of a ray inside a shape
+
+unsigned char img[W * H * 3];
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float segmentSDF(float x, float y, float ax, float ay, float bx, float by) {
+    float vx = x - ax, vy = y - ay, ux = bx - ax, uy = by - ay;
+    float t = fmaxf(fminf((vx * ux + vy * uy) / (ux * ux + uy * uy), 1.0f), 0.0f);
+    float dx = vx - ux * t, dy = vy - uy * t;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+float capsuleSDF(float x, float y, float ax, float ay, float bx, float by, float r) {
+    return segmentSDF(x, y, ax, ay, bx, by) - r;
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+float triangleSDF(float x, float y, float ax, float ay, float bx, float by, float cx, float cy) {
+    float d = fminf(fminf(
+        segmentSDF(x, y, ax, ay, bx, by),
+        segmentSDF(x, y, bx, by, cx, cy)),
+        segmentSDF(x, y, cx, cy, ax, ay));
+    return (bx - ax) * (y - ay) > (by - ay) * (x - ax) &&
+           (cx - bx) * (y - by) > (cy - by) * (x - bx) &&
+           (ax - cx) * (y - cy) > (ay - cy) * (x - cx) ? -d : d;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result subtractOp(Result a, Result b) {
+    Result r = a;
+    r.sd = (a.sd > -b.sd) ? a.sd : -b.sd;
+    return r;
+}
+
+float roundedBox(float x, float y) {
+    return boxSDF(x, y, 0.55f, 0.5f, -TWO_PI / 12.0f, 0.06f, 0.02f) - 0.04f;
+}
+
+Result scene(float x, float y) {
+    Result a = {   circleSDF(x, y, 0.25f, 0.25f, 0.15f), 1.0f };
+    Result b = {    planeSDF(x, y, 0.0f, 0.25f, 0.0f, 1.0f), 0.8f };
+    Result c = {  capsuleSDF(x, y, 0.6f, 0.15f, 0.85f, 0.35f, 0.05f), 1.0f };
+    Result d = {      boxSDF(x, y, 0.3f, 0.7f, TWO_PI / 16.0f, 0.15f, 0.05f), 0.8f };
+    Result e = { triangleSDF(x, y, 0.6f, 0.6f, 0.9f, 0.65f, 0.7f, 0.9f), 1.0f };
+    Result f = {   circleSDF(x, y, 0.73f, 0.71f, 0.05f), 0.0f };
+    Result g = {  roundedBox(x, y), 0.5f };
+    return unionOp(unionOp(unionOp(intersectOp(a, b), c), unionOp(d, subtractOp(e, f))), g);
+}
+
+float trace(float ox, float oy, float dx, float dy) {
+    float t = 0.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        Result r = scene(ox + dx * t, oy + dy * t);
+        if (r.sd < EPSILON)
+            return r.emissive;
+        t += r.sd;
+    }
+    return 0.0f;
+}
+
+Spans emptySpans() {
+    Spans s;
+    s.n = 0;
+    return s;
+}
+
+Spans oneSpan(float t0, float t1, float emissive) {
+    Spans s;
+    s.n = t0 <= t1 ? 1 : 0;
+    s.s[0].t0 = t0;
+    s.s[0].t1 = t1;
+    s.s[0].emissive = emissive;
+    return s;
+}
+
+void pushSpan(Spans* s, float t0, float t1, float emissive) {
+    if (t0 < t1 && s->n < MAX_SPAN) {
+        s->s[s->n].t0 = t0;
+        s->s[s->n].t1 = t1;
+        s->s[s->n].emissive = emissive;
+        s->n++;
+    }
+}
+
+Spans circleSpans(float ox, float oy, float dx, float dy, float cx, float cy, float r, float emissive) {
+    float ux = ox - cx, uy = oy - cy;
+    float b = ux * dx + uy * dy, c = ux * ux + uy * uy - r * r, disc = b * b - c;
+    if (disc < 0.0f)
+        return emptySpans();
+    float s = sqrtf(disc);
+    return oneSpan(-b - s, -b + s, emissive);
+}
+
+// Half-plane where planeSDF() is negative
+Spans planeSpans(float ox, float oy, float dx, float dy, float px, float py, float nx, float ny, float emissive) {
+    float s = planeSDF(ox, oy, px, py, nx, ny), dn = dx * nx + dy * ny;
+    if (dn == 0.0f)
+        return s < 0.0f ? oneSpan(-INF, INF, emissive) : emptySpans();
+    return dn > 0.0f ? oneSpan(-INF, -s / dn, emissive) : oneSpan(-s / dn, INF, emissive);
+}
+
+// Slab test in the local frame of the box
+Spans boxSpans(float ox, float oy, float dx, float dy, float cx, float cy, float theta, float sx, float sy, float emissive) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float lx = (ox - cx) * costheta + (oy - cy) * sintheta, ly = (oy - cy) * costheta - (ox - cx) * sintheta;
+    float ldx = dx * costheta + dy * sintheta, ldy = dy * costheta - dx * sintheta;
+    float t0 = -INF, t1 = INF;
+    if (ldx != 0.0f) {
+        float a = (-sx - lx) / ldx, b = (sx - lx) / ldx;
+        t0 = fmaxf(t0, fminf(a, b));
+        t1 = fminf(t1, fmaxf(a, b));
+    }
+    else if (fabsf(lx) > sx)
+        return emptySpans();
+    if (ldy != 0.0f) {
+        float a = (-sy - ly) / ldy, b = (sy - ly) / ldy;
+        t0 = fmaxf(t0, fminf(a, b));
+        t1 = fminf(t1, fmaxf(a, b));
+    }
+    else if (fabsf(ly) > sy)
+        return emptySpans();
+    return oneSpan(t0, t1, emissive);
+}
+
+Spans unionSpans(Spans a, Spans b) {
+    Spans r = emptySpans();
+    int i = 0, j = 0;
+    while (i < a.n || j < b.n) {
+        Span s = (j >= b.n || (i < a.n && a.s[i].t0 <= b.s[j].t0)) ? a.s[i++] : b.s[j++];
+        if (r.n > 0 && s.t0 <= r.s[r.n - 1].t1)
+            r.s[r.n - 1].t1 = fmaxf(r.s[r.n - 1].t1, s.t1);
+        else
+            pushSpan(&r, s.t0, s.t1, s.emissive);
+    }
+    return r;
+}
+
+// The entry of an overlap belongs to the span that starts later
+Spans intersectSpans(Spans a, Spans b) {
+    Spans r = emptySpans();
+    for (int i = 0; i < a.n; i++)
+        for (int j = 0; j < b.n; j++)
+            pushSpan(&r, fmaxf(a.s[i].t0, b.s[j].t0), fminf(a.s[i].t1, b.s[j].t1),
+                a.s[i].t0 >= b.s[j].t0 ? a.s[i].emissive : b.s[j].emissive);
+    return r;
+}
+
+// Pieces of a outside b keep the material of a, as in subtractOp()
+Spans subtractSpans(Spans a, Spans b) {
+    Spans r = emptySpans();
+    for (int i = 0; i < a.n; i++) {
+        float t0 = a.s[i].t0;
+        for (int j = 0; j < b.n && t0 < a.s[i].t1; j++)
+            if (b.s[j].t1 > t0 && b.s[j].t0 < a.s[i].t1) {
+                pushSpan(&r, t0, b.s[j].t0, a.s[i].emissive);
+                t0 = b.s[j].t1;
+            }
+        pushSpan(&r, t0, a.s[i].t1, a.s[i].emissive);
+    }
+    return r;
+}
+
+Spans capsuleSpans(float ox, float oy, float dx, float dy, float ax, float ay, float bx, float by, float r, float emissive) {
+    float ux = bx - ax, uy = by - ay, l = sqrtf(ux * ux + uy * uy);
+    return unionSpans(unionSpans(
+        circleSpans(ox, oy, dx, dy, ax, ay, r, emissive),
+        circleSpans(ox, oy, dx, dy, bx, by, r, emissive)),
+        boxSpans(ox, oy, dx, dy, (ax + bx) * 0.5f, (ay + by) * 0.5f, atan2f(uy, ux), l * 0.5f, r, emissive));
+}
+
+// Counter-clockwise triangle as intersection of three half-planes
+Spans triangleSpans(float ox, float oy, float dx, float dy, float ax, float ay, float bx, float by, float cx, float cy, float emissive) {
+    return intersectSpans(intersectSpans(
+        planeSpans(ox, oy, dx, dy, ax, ay, by - ay, ax - bx, emissive),
+        planeSpans(ox, oy, dx, dy, bx, by, cy - by, bx - cx, emissive)),
+        planeSpans(ox, oy, dx, dy, cx, cy, ay - cy, cx - ax, emissive));
+}
+
+// Fallback for shapes without closed-form intersection, assumed convex:
+// march to the entry, then march the negated distance to the exit
+Spans marchSpans(float ox, float oy, float dx, float dy, float (*sdf)(float, float), float emissive) {
+    float t0 = 0.0f, t1;
+    int i;
+    if (sdf(ox, oy) < 0.0f)
+        t0 = -INF;
+    else {
+        for (i = 0; i < MAX_STEP && t0 < MAX_DISTANCE; i++) {
+            float sd = sdf(ox + dx * t0, oy + dy * t0);
+            if (sd < EPSILON)
+                break;
+            t0 += sd;
+        }
+        if (i == MAX_STEP || t0 >= MAX_DISTANCE)
+            return emptySpans();
+    }
+    t1 = fmaxf(t0, 0.0f) + EPSILON;
+    for (i = 0; i < MAX_STEP && t1 < MAX_DISTANCE; i++) {
+        float sd = -sdf(ox + dx * t1, oy + dy * t1);
+        if (sd < EPSILON)
+            break;
+        t1 += sd;
+    }
+    return oneSpan(t0, t1, emissive);
+}
+
+Spans sceneSpans(float ox, float oy, float dx, float dy) {
+    Spans a = circleSpans(ox, oy, dx, dy, 0.25f, 0.25f, 0.15f, 1.0f);
+    Spans b = planeSpans(ox, oy, dx, dy, 0.0f, 0.25f, 0.0f, 1.0f, 0.8f);
+    Spans c = capsuleSpans(ox, oy, dx, dy, 0.6f, 0.15f, 0.85f, 0.35f, 0.05f, 1.0f);
+    Spans d = boxSpans(ox, oy, dx, dy, 0.3f, 0.7f, TWO_PI / 16.0f, 0.15f, 0.05f, 0.8f);
+    Spans e = triangleSpans(ox, oy, dx, dy, 0.6f, 0.6f, 0.9f, 0.65f, 0.7f, 0.9f, 1.0f);
+    Spans f = circleSpans(ox, oy, dx, dy, 0.73f, 0.71f, 0.05f, 0.0f);
+    Spans g = marchSpans(ox, oy, dx, dy, roundedBox, 0.5f);
+    return unionSpans(unionSpans(unionSpans(intersectSpans(a, b), c), unionSpans(d, subtractSpans(e, f))), g);
+}
+
+// The first span not entirely behind the origin is what the ray sees. Inside
+// a shape the material is the one of the nearest boundary, as given by scene().
+float traceSpans(float ox, float oy, float dx, float dy) {
+    Spans s = sceneSpans(ox, oy, dx, dy);
+    for (int i = 0; i < s.n; i++)
+        if (s.s[i].t1 >= 0.0f)
+            return s.s[i].t0 <= 0.0f ? scene(ox, oy).emissive : s.s[i].t0 < MAX_DISTANCE ? s.s[i].emissive : 0.0f;
+    return 0.0f;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += traceSpans(x, y, cosf(a), sinf(a));
+    }
+    return sum / N;
+}
+
+// Time both tracers on the same rays of a subset of pixels and count disagreements
+void compare() {
+    int rays = 0, differ = 0;
+    float sum[2] = { 0.0f, 0.0f };
+    for (int k = 0; k < 2; k++) {
+        clock_t start = clock();
+        for (int y = 0; y < H; y += 4)
+            for (int x = 0; x < W; x += 4)
+                for (int i = 0; i < N; i++) {
+                    float a = TWO_PI * (i + 0.5f) / N;
+                    sum[k] += k ? traceSpans((float)x / W, (float)y / H, cosf(a), sinf(a)) : trace((float)x / W, (float)y / H, cosf(a), sinf(a));
+                }
+        printf("%-8s %.2fs\n", k ? "analytic" : "march", (double)(clock() - start) / CLOCKS_PER_SEC);
+    }
+    for (int y = 0; y < H; y += 4)
+        for (int x = 0; x < W; x += 4)
+            for (int i = 0; i < N; i++, rays++) {
+                float a = TWO_PI * (i + 0.5f) / N;
+                differ += trace((float)x / W, (float)y / H, cosf(a), sinf(a)) != traceSpans((float)x / W, (float)y / H, cosf(a), sinf(a));
+            }
+    printf("%.3f%% of %d rays differ, mean radiance %f vs %f\n", 100.0 * differ / rays, rays, sum[0] / rays, sum[1] / rays);
+}
+
+int main() {
+    compare();
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("analytic.png", "wb"), W, H, img, 0);
+}
@@ -0,0 +1,316 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX, qsort(), atof()
+#include <stdio.h> // printf()
+#include <time.h> // clock_gettime()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define BUDGET 10.0             // Default wall-clock deadline in seconds
+#define PRE_N 4                 // Samples per pixel of the pre-pass
+#define PROBE 4                 // Pixel stride of the pre-pass
+#define MIN_N 1                 // Samples per pixel of a tile while the time left covers them
+#define MAX_N 4096
+#define TILE 32
+#define TILES_X (W / TILE)
+#define TILES_Y (H / TILE)
+#define REGION 4                // Tiles per side of a reported region
+#define WRITE_RESERVE 0.05      // Seconds kept for writing the PNG
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+
+typedef struct { int x, y, n; long long evaluations; float sigma, cost, plan; } Tile;
+
+unsigned char img[W * H * 3];
+Color accum[W * H], probe[H / PROBE][W / PROBE];
+Tile tiles[TILES_X * TILES_Y];
+long long evaluations;
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    evaluations++; // March steps and gradients of every depth, the cost measure of the pre-pass
+    float u = x - 0.5f, v = y - 0.5f, t = fmodf(atan2f(v, u) + TWO_PI, TWO_PI / 16), s = sqrtf(u * u + v * v);
+    x = fabsf(x - 0.5f) + 0.5f;
+    Color m = { 0.0f, 3.0f, 3.0f };
+    Result a = { ngonSDF(x, y, 0.7f, 0.35f, 0.2f, 16), 0.0f, 1.77f, BLACK, m };
+    Result b = { ngonSDF(x, y, 0.35f, 0.35f, 0.55f, 32), 0.0f, 1.77f, BLACK, m };
+    Result c = {  planeSDF(x, y, 0.5f, 0.35f, 0.0f, -1.0f), 0.0f, 1.77f, BLACK, m };
+    // y = fabsf(y - 0.5f) + 0.5f;
+    // Result d = { circleSDF(x, y, 1.05f, 1.05f, 0.05f), 0.0f, 0.0f, { 5.0f, 5.0f, 5.0f }, BLACK };
+    // Result d = { -circleSDF(x, y, 0.5f, 0.5f, 3.0f), 0.0f, 0.0f, { 0.5f, 0.5f, 0.5f }, BLACK };
+    Result d = { circleSDF(s * cosf(t), s * sinf(t), 0.6f * cosf(TWO_PI / 32), 0.5f * sinf(TWO_PI / 32), 0.05f), 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK };
+    return unionOp(unionOp(a, intersectOp(b, c)), d);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            Color sum = r.emissive;
+            if (depth < MAX_DEPTH && r.eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            Color c = colorMultiply(sum, beerLambert(r.absorption, t));
+            return c;
+        }
+        t += r.sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+float luminance(Color c) {
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+// Adds n stratified samples to the sum of a pixel, returns the sum of their squared luminance
+float sample(float x, float y, int n, Color* sum) {
+    float squares = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / n;
+        Color c = trace(x, y, cosf(a), sinf(a), 0);
+        float l = luminance(c);
+        *sum = colorAdd(*sum, c);
+        squares += l * l;
+    }
+    return squares;
+}
+
+// Predicted seconds of the planned samples, most expensive first
+int compareTiles(const void* a, const void* b) {
+    const Tile* p = a, * q = b;
+    float u = p->cost * p->plan, v = q->cost * q->plan;
+    return u < v ? 1 : u > v ? -1 : 0;
+}
+
+// Samples of a tile from a fractional plan, rounded stochastically so that short budgets are not truncated
+int samples(float plan, int floor) {
+    int n = (int)plan;
+    n += (float)rand() / RAND_MAX < plan - n;
+    return n < floor ? floor : n > MAX_N ? MAX_N : n;
+}
+
+// Usage: ./budget [seconds]
+// A pre-pass of PRE_N samples on every PROBE-th pixel in each direction
+// measures the scene evaluations and the luminance variance of each tile. The evaluations are converted to seconds
+// per sample at the rate of the pre-pass, and the remaining time is split to
+// minimize the summed variance, sigma^2 / n, at that cost: n is proportional
+// to sigma / sqrt(cost). Tiles run most expensive first, and before each one
+// the plan of the rest is rescaled to the time actually left, so errors of
+// the prediction are corrected while cheap tiles remain to absorb them.
+// A tile gets at least MIN_N samples while the time left covers MIN_N for
+// all remaining tiles. Below that the deadline wins: tiles may get no samples
+// and are filled from the pre-pass, and the budget is reported as too short.
+int main(int argc, char* argv[]) {
+    double budget = argc > 1 ? atof(argv[1]) : BUDGET, start = now(), deadline = start + budget - WRITE_RESERVE;
+    int count = TILES_X * TILES_Y;
+
+    // Pre-pass, its samples only serve the prediction
+    double sigmaSum = 0.0;
+    for (int i = 0; i < count; i++) {
+        Tile* t = &tiles[i];
+        double variance = 0.0;
+        long long before = evaluations;
+        t->x = i % TILES_X * TILE;
+        t->y = i / TILES_X * TILE;
+        for (int y = t->y + PROBE / 2; y < t->y + TILE; y += PROBE)
+            for (int x = t->x + PROBE / 2; x < t->x + TILE; x += PROBE) {
+                Color sum = BLACK;
+                float squares = sample((float)x / W, (float)y / H, PRE_N, &sum);
+                float mean = luminance(sum) / PRE_N;
+                probe[y / PROBE][x / PROBE] = colorScale(sum, 1.0f / PRE_N);
+                variance += fmaxf(squares - PRE_N * mean * mean, 0.0f) / (PRE_N - 1);
+            }
+        t->evaluations = evaluations - before;
+        t->sigma = sqrtf(variance / (TILE * TILE / (PROBE * PROBE)));
+        sigmaSum += t->sigma;
+    }
+    double prepass = now() - start, rate = prepass / evaluations;
+
+    // Plan, with a floor on sigma so that tiles noiseless at PRE_N still get samples
+    double weightSum = 0.0, left = deadline - now();
+    for (int i = 0; i < count; i++) {
+        Tile* t = &tiles[i];
+        t->sigma = fmaxf(t->sigma, 0.1f * sigmaSum / count);
+        t->cost = t->evaluations * rate * (PROBE * PROBE) / PRE_N;
+        weightSum += t->sigma * sqrtf(t->cost);
+    }
+    double planned = 0.0, floorCost = 0.0;
+    for (int i = 0; i < count; i++) {
+        Tile* t = &tiles[i];
+        t->plan = left > 0.0 ? fminf(left / weightSum * t->sigma / sqrtf(t->cost), MAX_N) : 0.0f;
+        planned += t->cost * t->plan;
+        floorCost += t->cost * MIN_N;
+    }
+    if (floorCost > left)
+        printf("budget too short: %d spp everywhere needs %.2fs but %.2fs are left, some tiles fall back to the pre-pass\n", MIN_N, floorCost, left);
+    qsort(tiles, count, sizeof(Tile), compareTiles);
+
+    // Render, rescaling the rest of the plan to the time left
+    double renderStart = now();
+    for (int i = 0; i < count; i++) {
+        Tile* t = &tiles[i];
+        double rest = 0.0, restFloor = 0.0, remaining = deadline - now();
+        for (int j = i; j < count; j++) {
+            rest += tiles[j].cost * tiles[j].plan;
+            restFloor += tiles[j].cost * MIN_N;
+        }
+        double scale = rest > 0.0 ? remaining / rest : 0.0;
+        t->n = samples(t->plan * fmaxf(scale, 0.0f), remaining >= restFloor ? MIN_N : 0);
+        for (int y = t->y; y < t->y + TILE; y++)
+            for (int x = t->x; x < t->x + TILE; x++)
+                sample((float)x / W, (float)y / H, t->n, &accum[y * W + x]);
+    }
+    double render = now() - renderStart;
+
+    // Tiles without samples show the nearest pre-pass pixel
+    unsigned char* p = img;
+    int spp[TILES_Y][TILES_X], fallback = 0;
+    float noise[TILES_Y][TILES_X];
+    for (int i = 0; i < count; i++) {
+        spp[tiles[i].y / TILE][tiles[i].x / TILE] = tiles[i].n;
+        noise[tiles[i].y / TILE][tiles[i].x / TILE] = tiles[i].sigma / sqrtf(tiles[i].n > 0 ? tiles[i].n : PRE_N);
+        fallback += tiles[i].n == 0;
+    }
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            int n = spp[y / TILE][x / TILE];
+            Color c = n > 0 ? colorScale(accum[y * W + x], 1.0f / n) : probe[y / PROBE][x / PROBE];
+            p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+            p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+            p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+        }
+    svpng(fopen("budget.png", "wb"), W, H, img, 0);
+
+    // Report mean spp and the standard error of luminance of regions of REGION x REGION tiles
+    long long total = 0;
+    int minSPP = MAX_N, maxSPP = 0;
+    for (int i = 0; i < count; i++) {
+        total += tiles[i].n;
+        minSPP = tiles[i].n < minSPP ? tiles[i].n : minSPP;
+        maxSPP = tiles[i].n > maxSPP ? tiles[i].n : maxSPP;
+    }
+    printf("budget %.2fs  elapsed %.2fs  pre-pass %.2fs  render %.2fs (planned %.2fs)\n", budget, now() - start, prepass, render, planned);
+    printf("spp per tile: min %d  mean %.1f  max %d\n", minSPP, (double)total / count, maxSPP);
+    if (fallback)
+        printf("%d of %d tiles filled from the pre-pass\n", fallback, count);
+    printf("region mean spp / standard error\n");
+    for (int ry = 0; ry < TILES_Y; ry += REGION) {
+        for (int rx = 0; rx < TILES_X; rx += REGION) {
+            double s = 0.0, e = 0.0;
+            for (int y = ry; y < ry + REGION && y < TILES_Y; y++)
+                for (int x = rx; x < rx + REGION && x < TILES_X; x++) {
+                    s += spp[y][x];
+                    e += noise[y][x] * noise[y][x];
+                }
+            printf(" %5.0f/%.4f", s / (REGION * REGION), sqrt(e / (REGION * REGION)));
+        }
+        printf("\n");
+    }
+}
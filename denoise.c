@@ -0,0 +1,207 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), expf(), powf()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 32
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define ITERATIONS 4            // A-trous passes with step 1, 2, 4, ...
+#define SIGMA_COLOR 4.0f        // Edge stopping by luminance difference in standard deviations
+#define SIGMA_NORMAL 32.0f      // Exponent of the normal similarity
+#define SIGMA_DISTANCE 1.0f     // Edge stopping by SDF difference relative to pixel distance
+#define DEGENERATE 1e-3f        // Gradient length below which a pixel has no normal
+#define OUTPUT_AUX 0            // Also write the noisy input and feature buffers
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+typedef struct { float color, variance, distance, nx, ny; int material; } Feature;
+
+unsigned char img[W * H * 3];
+Feature features[W * H];
+float color[2][W * H], variance[2][W * H];
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result c = { circleSDF(x, y, 0.5f, -0.5f, 0.05f), 20.0f, 0.0f, 0.0f };
+    Result d = { circleSDF(x, y, 0.5f, 0.2f, 0.35f), 0.0f, 0.2f, 1.5f };
+    Result e = { circleSDF(x, y, 0.5f, 0.8f, 0.35f), 0.0f, 0.2f, 1.5f };
+    return unionOp(c, intersectOp(d, e));
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+// Radiance estimate with its variance, plus the features at the pixel:
+// SDF distance, normalized SDF gradient and material (0 air, 1 emitter, 2 other)
+Feature sample(float x, float y) {
+    Feature f;
+    float sum = 0.0f, sum2 = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        float c = trace(x, y, cosf(a), sinf(a), 0);
+        sum += c;
+        sum2 += c * c;
+    }
+    f.color = sum / N;
+    f.variance = fmaxf(sum2 / N - f.color * f.color, 0.0f) / N;
+    Result r = scene(x, y);
+    gradient(x, y, &f.nx, &f.ny);
+    float l = sqrtf(f.nx * f.nx + f.ny * f.ny), s = l > DEGENERATE ? 1.0f / l : 0.0f;
+    f.nx *= s; // Zero where the gradient vanishes, such as the medial axis of the lens
+    f.ny *= s;
+    f.distance = r.sd;
+    f.material = r.sd > 0.0f ? 0 : r.emissive > 0.0f ? 1 : 2;
+    return f;
+}
+
+// One edge-avoiding a-trous wavelet pass with a 5x5 B3 spline kernel
+void atrous(int step, const float* inColor, const float* inVariance, float* outColor, float* outVariance) {
+    static const float kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            const Feature* p = &features[y * W + x];
+            float cp = inColor[y * W + x], v = 0.0f;
+            for (int j = -1; j <= 1; j++) // Variance is prefiltered by a 3x3 Gaussian
+                for (int i = -1; i <= 1; i++) {
+                    int qx = x + i < 0 ? 0 : x + i >= W ? W - 1 : x + i, qy = y + j < 0 ? 0 : y + j >= H ? H - 1 : y + j;
+                    v += inVariance[qy * W + qx] * (2 - abs(i)) * (2 - abs(j)) / 16.0f;
+                }
+            float sigma = SIGMA_COLOR * sqrtf(v) + 1e-4f;
+            float sum = 0.0f, sumVariance = 0.0f, weight = 0.0f;
+            for (int j = -2; j <= 2; j++)
+                for (int i = -2; i <= 2; i++) {
+                    int qx = x + i * step, qy = y + j * step;
+                    if (qx < 0 || qx >= W || qy < 0 || qy >= H)
+                        continue;
+                    const Feature* q = &features[qy * W + qx];
+                    if (q->material != p->material)
+                        continue;
+                    float cq = inColor[qy * W + qx], w = kernel[0] * kernel[0];
+                    if (i != 0 || j != 0) { // The center tap keeps its full weight, so the sum of weights is positive
+                        w = kernel[abs(i)] * kernel[abs(j)] *
+                            expf(-fabsf(cp - cq) / sigma
+                                 -fabsf(p->distance - q->distance) * W / (SIGMA_DISTANCE * step * (abs(i) + abs(j))));
+                        if ((p->nx != 0.0f || p->ny != 0.0f) && (q->nx != 0.0f || q->ny != 0.0f))
+                            w *= powf(fmaxf(p->nx * q->nx + p->ny * q->ny, 0.0f), SIGMA_NORMAL);
+                    }
+                    sum += w * cq;
+                    sumVariance += w * w * inVariance[qy * W + qx];
+                    weight += w;
+                }
+            outColor[y * W + x] = sum / weight;
+            outVariance[y * W + x] = sumVariance / (weight * weight);
+        }
+}
+
+void output(const char* filename, const float* buffer, float scale, float offset) {
+    unsigned char* p = img;
+    for (int i = 0; i < W * H; i++, p += 3)
+        p[0] = p[1] = p[2] = (int)(fmaxf(fminf(buffer[i] * scale + offset, 255.0f), 0.0f));
+    svpng(fopen(filename, "wb"), W, H, img, 0);
+}
+
+int main() {
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            Feature* f = &features[y * W + x];
+            *f = sample((float)x / W, (float)y / H);
+            color[0][y * W + x] = f->color;
+            variance[0][y * W + x] = f->variance;
+        }
+
+#if OUTPUT_AUX
+    static float aux[W * H];
+    output("denoise_noisy.png", color[0], 255.0f, 0.0f);
+    for (int i = 0; i < W * H; i++) aux[i] = features[i].distance;
+    output("denoise_distance.png", aux, 255.0f, 127.5f);
+    for (int i = 0; i < W * H; i++) aux[i] = features[i].nx;
+    output("denoise_normalx.png", aux, 127.5f, 127.5f);
+    for (int i = 0; i < W * H; i++) aux[i] = features[i].ny;
+    output("denoise_normaly.png", aux, 127.5f, 127.5f);
+    for (int i = 0; i < W * H; i++) aux[i] = (float)features[i].material;
+    output("denoise_material.png", aux, 127.5f, 0.0f);
+    output("denoise_variance.png", variance[0], 255.0f * 16.0f, 0.0f);
+#endif
+
+    for (int k = 0; k < ITERATIONS; k++)
+        atrous(1 << k, color[k & 1], variance[k & 1], color[(k + 1) & 1], variance[(k + 1) & 1]);
+    output("denoise.png", color[ITERATIONS & 1], 255.0f, 0.0f);
+}
@@ -0,0 +1,393 @@
+#include "svpng.inc"
+#include <math.h> // fabs(), fmin(), fmax(), sin(), cos(), sqrt(), pow()
+#include <stdlib.h> // rand(), RAND_MAX, srand()
+#include <string.h> // memset(), memcpy()
+
+#define TWO_PI 6.28318530718
+#define W 64
+#define H 64
+#define N 64
+#define TARGET_N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0
+#define EPSILON 1e-6
+#define BIAS 1e-4
+#define MAX_DEPTH 3
+#define MAX_NODE 16             // Nodes of a ray tree up to MAX_DEPTH
+#define EMISSIVE 20.0
+#define P 3                     // Parameters: eta, radius of the lens circles and half thickness
+#define OMEGA P                 // Derivative with respect to the angle of the sample
+#define BISECT 1e-8             // Angular width to which a discontinuity is located
+#define CORNER 1e-4             // Distance within which a hit is at the corner of the lens
+#define GRAZE 0.05              // Search interval of the tangent point around a grazing hit
+#define CHECK_N 65536           // Samples of a probe pixel in the gradient check
+#define CHECK_TOLERANCE 0.1     // Relative error of a derivative against its finite difference
+#define FD_STEP 1e-2
+#define PROBES 2
+#define ITERATIONS 60
+#define RATE 0.004              // Step of Adam
+#define SCALE 4                 // Upscaling of the panels in the output
+
+enum { MISS = -1, LIGHT, LOWER, UPPER };    // Faces of the scene
+enum { ROOT, REFRACTED, REFLECTED };        // Kinds of ray in a tree
+
+// Value with derivatives with respect to the parameters and the sample angle
+typedef struct { double v, d[P + 1]; } Dual;
+typedef struct { int kind, face; double t; Dual ox, oy, dx, dy; } Node;
+typedef struct { int n; Node nodes[MAX_NODE]; } Tree;
+
+const char* paramNames[P] = { "eta", "radius", "half" };
+const double probes[PROBES][2] = { { 0.45, 0.7 }, { 0.5, 0.8 } }; // Pixels in the caustic, sensitive to every parameter
+double params[P];
+double target[H][W], image[H][W], grad[H][W][P];
+unsigned char img[H * SCALE * W * SCALE * 3 * 3];
+
+Dual constant(double v) {
+    Dual a;
+    a.v = v;
+    memset(a.d, 0, sizeof(a.d));
+    return a;
+}
+
+Dual variable(double v, int k) {
+    Dual a = constant(v);
+    a.d[k] = 1.0;
+    return a;
+}
+
+Dual add(Dual a, Dual b) {
+    a.v += b.v;
+    for (int k = 0; k <= P; k++)
+        a.d[k] += b.d[k];
+    return a;
+}
+
+Dual sub(Dual a, Dual b) {
+    a.v -= b.v;
+    for (int k = 0; k <= P; k++)
+        a.d[k] -= b.d[k];
+    return a;
+}
+
+Dual mul(Dual a, Dual b) {
+    Dual c;
+    c.v = a.v * b.v;
+    for (int k = 0; k <= P; k++)
+        c.d[k] = a.d[k] * b.v + a.v * b.d[k];
+    return c;
+}
+
+Dual divide(Dual a, Dual b) {
+    Dual c;
+    c.v = a.v / b.v;
+    for (int k = 0; k <= P; k++)
+        c.d[k] = (a.d[k] - c.v * b.d[k]) / b.v;
+    return c;
+}
+
+Dual scale(Dual a, double s) {
+    a.v *= s;
+    for (int k = 0; k <= P; k++)
+        a.d[k] *= s;
+    return a;
+}
+
+Dual root(Dual a) {
+    Dual c;
+    c.v = sqrt(a.v);
+    for (int k = 0; k <= P; k++)
+        c.d[k] = a.d[k] * 0.5 / c.v;
+    return c;
+}
+
+// The biconvex lens of refraction.c, the intersection of two circles of the
+// same radius offset from the center, below the light of that scene. The
+// offset is derived from the half thickness, which decouples the parameters.
+Dual faceSDF(int face, Dual x, Dual y) {
+    Dual ux = sub(x, constant(0.5));
+    if (face == LIGHT) {
+        Dual uy = sub(y, constant(-0.5));
+        return sub(root(add(mul(ux, ux), mul(uy, uy))), constant(0.05));
+    }
+    Dual offset = sub(variable(params[1], 1), variable(params[2], 2)), uy = face == LOWER ? add(sub(y, constant(0.5)), offset) : sub(sub(y, constant(0.5)), offset);
+    return sub(root(add(mul(ux, ux), mul(uy, uy))), variable(params[1], 1));
+}
+
+double faceDistance(int face, double x, double y) {
+    double offset = params[1] - params[2], ux = x - 0.5, uy = face == LIGHT ? y + 0.5 : face == LOWER ? y - 0.5 + offset : y - 0.5 - offset;
+    return sqrt(ux * ux + uy * uy) - (face == LIGHT ? 0.05 : params[1]);
+}
+
+double sceneDistance(double x, double y, int* face) {
+    double a = faceDistance(LIGHT, x, y), b = faceDistance(LOWER, x, y), c = faceDistance(UPPER, x, y);
+    double lens = b > c ? b : c;
+    *face = a < lens ? LIGHT : b > c ? LOWER : UPPER;
+    return a < lens ? a : lens;
+}
+
+Dual fresnel(Dual cosi, Dual cost, Dual etai, Dual etat) {
+    Dual rs = divide(sub(mul(etat, cosi), mul(etai, cost)), add(mul(etat, cosi), mul(etai, cost)));
+    Dual rp = divide(sub(mul(etai, cosi), mul(etat, cost)), add(mul(etai, cosi), mul(etat, cost)));
+    return scale(add(mul(rs, rs), mul(rp, rp)), 0.5);
+}
+
+// The tracer of fresnel.c in dual numbers, whose Fresnel term keeps the
+// radiance continuous at total internal reflection and at grazing incidence.
+// The hit distance is differentiated implicitly from sdf(o + t d) = 0, so the
+// hit point and normal move with the parameters. Each ray is recorded in the
+// tree in depth first order, which identifies the branch of the path space.
+Dual trace(Dual ox, Dual oy, Dual dx, Dual dy, int depth, int kind, Tree* tree) {
+    Node* node = &tree->nodes[tree->n++];
+    int face;
+    double t = 1e-3, sign = sceneDistance(ox.v, oy.v, &face) > 0.0 ? 1.0 : -1.0;
+    node->kind = kind;
+    node->face = MISS;
+    node->t = MAX_DISTANCE;
+    node->ox = ox;
+    node->oy = oy;
+    node->dx = dx;
+    node->dy = dy;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        double sd = sceneDistance(ox.v + dx.v * t, oy.v + dy.v * t, &face);
+        if (sd * sign < EPSILON) {
+            node->face = face;
+            node->t = t;
+            if (face == LIGHT)
+                return constant(EMISSIVE);
+            if (depth >= MAX_DEPTH)
+                return constant(0.0);
+            Dual x = add(ox, scale(dx, t)), y = add(oy, scale(dy, t)), g = faceSDF(face, x, y), tt = constant(t);
+            double gx = (faceDistance(face, x.v + EPSILON, y.v) - faceDistance(face, x.v - EPSILON, y.v)) * (0.5 / EPSILON);
+            double gy = (faceDistance(face, x.v, y.v + EPSILON) - faceDistance(face, x.v, y.v - EPSILON)) * (0.5 / EPSILON);
+            for (int k = 0; k <= P; k++)
+                tt.d[k] = -g.d[k] / (gx * dx.v + gy * dy.v);
+            x = add(ox, mul(dx, tt));
+            y = add(oy, mul(dy, tt));
+
+            Dual e = constant(EPSILON);
+            Dual nx = scale(sub(faceSDF(face, add(x, e), y), faceSDF(face, sub(x, e), y)), 0.5 / EPSILON);
+            Dual ny = scale(sub(faceSDF(face, x, add(y, e)), faceSDF(face, x, sub(y, e))), 0.5 / EPSILON);
+            Dual length = scale(root(add(mul(nx, nx), mul(ny, ny))), sign);
+            nx = divide(nx, length);
+            ny = divide(ny, length);
+
+            Dual one = constant(1.0), eta = variable(params[0], 0), sum = constant(0.0), refl = one;
+            Dual idotn = add(mul(dx, nx), mul(dy, ny)), ratio = sign < 0.0 ? eta : divide(one, eta);
+            Dual k = sub(one, mul(mul(ratio, ratio), sub(one, mul(idotn, idotn))));
+            if (k.v >= 0.0) {
+                Dual a = add(mul(ratio, idotn), root(k));
+                Dual rx = sub(mul(ratio, dx), mul(a, nx)), ry = sub(mul(ratio, dy), mul(a, ny));
+                Dual cosi = scale(idotn, -1.0), cost = scale(add(mul(rx, nx), mul(ry, ny)), -1.0);
+                refl = sign < 0.0 ? fresnel(cosi, cost, eta, one) : fresnel(cosi, cost, one, eta);
+                Dual child = trace(sub(x, scale(nx, BIAS)), sub(y, scale(ny, BIAS)), rx, ry, depth + 1, REFRACTED, tree);
+                sum = mul(sub(one, refl), child);
+            } // Otherwise total internal reflection
+            Dual rx = sub(dx, scale(mul(idotn, nx), 2.0)), ry = sub(dy, scale(mul(idotn, ny), 2.0));
+            Dual child = trace(add(x, scale(nx, BIAS)), add(y, scale(ny, BIAS)), rx, ry, depth + 1, REFLECTED, tree);
+            return add(sum, mul(refl, child));
+        }
+        t += sd * sign;
+    }
+    return constant(0.0);
+}
+
+Dual evaluate(double x, double y, double angle, Tree* tree) {
+    Dual dx = constant(cos(angle)), dy = constant(sin(angle));
+    dx.d[OMEGA] = -sin(angle);
+    dy.d[OMEGA] = cos(angle);
+    tree->n = 0;
+    return trace(constant(x), constant(y), dx, dy, 0, ROOT, tree);
+}
+
+int sameBranch(const Tree* a, const Tree* b) {
+    if (a->n != b->n)
+        return 0;
+    for (int i = 0; i < a->n; i++)
+        if (a->nodes[i].kind != b->nodes[i].kind || a->nodes[i].face != b->nodes[i].face)
+            return 0;
+    return 1;
+}
+
+// Boundary term of a discontinuity located between two nearby angles, the
+// jump of the radiance times the velocity of the discontinuity in angle,
+// d angle / d param = -(dh / d param) / (dh / d angle) for a function h that
+// vanishes on it. The first ray that differs in the two trees either grazes
+// a face, where h is the distance of the face at the tangent point (which is
+// stationary along the ray, so the point may be held fixed), or passes the
+// corner of the lens, where both faces vanish at a point of the ray, solved
+// for the distance along the ray and the angle.
+void discontinuity(const Tree* lo, const Tree* hi, double jump, double dI[P]) {
+    int j = 0;
+    while (j < lo->n && j < hi->n && lo->nodes[j].kind == hi->nodes[j].kind && lo->nodes[j].face == hi->nodes[j].face)
+        j++;
+    if (jump == 0.0 || j == lo->n || j == hi->n || lo->nodes[j].kind != hi->nodes[j].kind)
+        return; // No jump, or a change of branch at total internal reflection where the radiance is continuous
+    const Node* near = lo->nodes[j].t <= hi->nodes[j].t ? &lo->nodes[j] : &hi->nodes[j];
+    int face = near->face, other = face == LOWER ? UPPER : face == UPPER ? LOWER : MISS;
+    double t = near->t, velocity[P];
+    int corner = other != MISS && fabs(faceDistance(other, near->ox.v + near->dx.v * t, near->oy.v + near->dy.v * t)) < CORNER;
+    if (!corner) {
+        // The hit of a grazing ray is far from the tangent point, where the distance is stationary
+        double a = fmax(t - GRAZE, 0.0), b = t + GRAZE;
+        for (int i = 0; i < 64; i++) {
+            double u = a + (b - a) / 3.0, v = b - (b - a) / 3.0;
+            if (faceDistance(face, near->ox.v + near->dx.v * u, near->oy.v + near->dy.v * u) < faceDistance(face, near->ox.v + near->dx.v * v, near->oy.v + near->dy.v * v))
+                b = v;
+            else
+                a = u;
+        }
+        t = (a + b) * 0.5;
+    }
+    Dual x = add(near->ox, scale(near->dx, t)), y = add(near->oy, scale(near->dy, t));
+    Dual f = faceSDF(face, x, y);
+    if (corner) {
+        Dual g = faceSDF(other, x, y);
+        double e = EPSILON, dx = near->dx.v, dy = near->dy.v;
+        double ft = (faceDistance(face, x.v + dx * e, y.v + dy * e) - faceDistance(face, x.v - dx * e, y.v - dy * e)) * (0.5 / e);
+        double gt = (faceDistance(other, x.v + dx * e, y.v + dy * e) - faceDistance(other, x.v - dx * e, y.v - dy * e)) * (0.5 / e);
+        double det = ft * g.d[OMEGA] - f.d[OMEGA] * gt;
+        for (int k = 0; k < P; k++)
+            velocity[k] = (gt * f.d[k] - ft * g.d[k]) / det;
+    }
+    else
+        for (int k = 0; k < P; k++)
+            velocity[k] = -f.d[k] / f.d[OMEGA];
+    for (int k = 0; k < P; k++)
+        dI[k] += jump * velocity[k] / TWO_PI;
+}
+
+// Bisects an interval of angles whose ends take different branches down to
+// the discontinuities in it, as long as they change the branch an odd number
+// of times in each half
+void bisect(double x, double y, double a, double b, const Tree* ta, double fa, const Tree* tb, double fb, double dI[P]) {
+    if (sameBranch(ta, tb))
+        return;
+    if (b - a < BISECT) {
+        discontinuity(ta, tb, fa - fb, dI);
+        return;
+    }
+    Tree tm;
+    double m = (a + b) * 0.5, fm = evaluate(x, y, m, &tm).v;
+    bisect(x, y, a, m, ta, fa, &tm, fm, dI);
+    bisect(x, y, m, b, &tm, fm, tb, fb, dI);
+}
+
+// Pixel value with its derivatives: the interior term from the dual numbers
+// of stratified samples, and the boundary term of the discontinuities found
+// between consecutive samples
+double sample(double x, double y, int n, double dI[P]) {
+    Tree first, previous, current;
+    first.n = previous.n = 0;
+    double sum = 0.0, firstAngle = 0.0, firstValue = 0.0, previousAngle = 0.0, previousValue = 0.0;
+    if (dI)
+        memset(dI, 0, sizeof(double) * P);
+    for (int i = 0; i < n; i++) {
+        double a = TWO_PI * (i + (double)rand() / RAND_MAX) / n;
+        Dual f = evaluate(x, y, a, &current);
+        sum += f.v;
+        if (!dI)
+            continue;
+        for (int k = 0; k < P; k++)
+            dI[k] += f.d[k] / n;
+        if (i == 0) {
+            first = current;
+            firstAngle = a;
+            firstValue = f.v;
+        }
+        else
+            bisect(x, y, previousAngle, a, &previous, previousValue, &current, f.v, dI);
+        previous = current;
+        previousAngle = a;
+        previousValue = f.v;
+    }
+    if (dI)
+        bisect(x, y, previousAngle, firstAngle + TWO_PI, &previous, previousValue, &first, firstValue, dI);
+    return sum / n;
+}
+
+// Mean squared error to the target, and its gradient from one pass that
+// carries the derivatives of all parameters
+double render(int n, double dL[P]) {
+    double loss = 0.0;
+    srand(1);
+    if (dL)
+        memset(dL, 0, sizeof(double) * P);
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            image[y][x] = sample((double)x / W, (double)y / H, n, dL ? grad[y][x] : NULL);
+            double e = image[y][x] - target[y][x];
+            loss += e * e / (W * H);
+            for (int k = 0; dL && k < P; k++)
+                dL[k] += 2.0 * e * grad[y][x][k] / (W * H);
+        }
+    return loss;
+}
+
+void panel(int i) {
+    for (int y = 0; y < H * SCALE; y++)
+        for (int x = 0; x < W * SCALE; x++) {
+            unsigned char* p = img + (y * W * SCALE * 3 + i * W * SCALE + x) * 3;
+            p[0] = p[1] = p[2] = (int)(fmin(image[y / SCALE][x / SCALE] * 255.0, 255.0));
+        }
+}
+
+// Checks the derivatives of the radiance of the probe pixels against central
+// finite differences with the same samples. The loss of the whole image is
+// not checked, since its finite differences are dominated by the pixels on
+// caustic folds, where the derivative is unbounded.
+int check() {
+    int ok = 1;
+    for (int i = 0; i < PROBES; i++) {
+        double dI[P], x = probes[i][0], y = probes[i][1];
+        srand(1);
+        sample(x, y, CHECK_N, dI);
+        for (int k = 0; k < P; k++) {
+            double p = params[k];
+            params[k] = p + FD_STEP;
+            srand(1);
+            double i1 = sample(x, y, CHECK_N, NULL);
+            params[k] = p - FD_STEP;
+            srand(1);
+            double i0 = sample(x, y, CHECK_N, NULL);
+            params[k] = p;
+            double fd = (i1 - i0) / (2.0 * FD_STEP);
+            int match = fabs(dI[k] - fd) <= CHECK_TOLERANCE * fabs(fd);
+            printf("d I(%.2f, %.2f) / d %-6s %10.6f  finite difference %10.6f  %s\n", x, y, paramNames[k], dI[k], fd, match ? "ok" : "MISMATCH");
+            ok &= match;
+        }
+    }
+    return ok;
+}
+
+// Recovers the lens of a target image from a perturbed one by gradient
+// descent, after checking the gradient. Returns 1 if the check fails.
+// The output shows the target, the initial and the optimized images, all
+// rendered with the samples of the target.
+int main() {
+    double truth[P] = { 1.5, 0.35, 0.05 }, initial[P] = { 1.4, 0.4, 0.06 }, dL[P], m[P] = { 0 }, v[P] = { 0 };
+    memcpy(params, truth, sizeof(params));
+    render(TARGET_N, NULL);
+    memcpy(target, image, sizeof(target));
+    panel(0);
+    printf("loss at the truth %.6f (noise of %d samples)\n", render(N, NULL), N);
+
+    memcpy(params, initial, sizeof(params));
+    if (!check())
+        return 1;
+    render(TARGET_N, NULL);
+    panel(1);
+    double loss = render(N, dL);
+
+    for (int i = 1; i <= ITERATIONS; i++) {
+        for (int k = 0; k < P; k++) {
+            m[k] = 0.9 * m[k] + 0.1 * dL[k];
+            v[k] = 0.999 * v[k] + 0.001 * dL[k] * dL[k];
+            params[k] -= RATE * (m[k] / (1.0 - pow(0.9, i))) / (sqrt(v[k] / (1.0 - pow(0.999, i))) + 1e-12);
+        }
+        loss = render(N, dL);
+        printf("%2d loss %.6f  eta %.4f  radius %.4f  half %.4f\n", i, loss, params[0], params[1], params[2]);
+    }
+    render(TARGET_N, NULL);
+    panel(2);
+    svpng(fopen("differentiable.png", "wb"), W * SCALE * 3, H * SCALE, img, 0);
+}
@@ -0,0 +1,230 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // atoi(), exit()
+#include <unistd.h> // fork(), read(), write(), close()
+#include <sys/socket.h> // socketpair()
+#include <sys/wait.h> // waitpid()
+
+#define TWO_PI 6.28318530718f
+#define W 1024
+#define H 1024
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define MAX_WORKERS 64
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+
+unsigned char img[W * H * 3];
+float accum[W * H * 3], part[W * H * 3];
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    float u = x - 0.5f, v = y - 0.5f, t = fmodf(atan2f(v, u) + TWO_PI, TWO_PI / 16), s = sqrtf(u * u + v * v);
+    x = fabsf(x - 0.5f) + 0.5f;
+    Color m = { 0.0f, 3.0f, 3.0f };
+    Result a = { ngonSDF(x, y, 0.7f, 0.35f, 0.2f, 16), 0.0f, 1.77f, BLACK, m };
+    Result b = { ngonSDF(x, y, 0.35f, 0.35f, 0.55f, 32), 0.0f, 1.77f, BLACK, m };
+    Result c = {  planeSDF(x, y, 0.5f, 0.35f, 0.0f, -1.0f), 0.0f, 1.77f, BLACK, m };
+    Result d = { circleSDF(s * cosf(t), s * sinf(t), 0.6f * cosf(TWO_PI / 32), 0.5f * sinf(TWO_PI / 32), 0.05f), 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK };
+    return unionOp(unionOp(a, intersectOp(b, c)), d);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            Color sum = r.emissive;
+            if (depth < MAX_DEPTH && r.eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            Color c = colorMultiply(sum, beerLambert(r.absorption, t));
+            return c;
+        }
+        t += r.sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+// Stateless random number in [0, 1) of sample i of a pixel, so the jitter
+// does not depend on which worker renders the sample
+float jitter(unsigned pixel, unsigned i) {
+    unsigned h = pixel * 0x9e3779b9u ^ i * 0x85ebca6bu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+// Unnormalized sum of samples [begin, end) of each pixel
+void render(int begin, int end, float* out) {
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, out += 3) {
+            Color sum = BLACK;
+            for (int i = begin; i < end; i++) {
+                float a = TWO_PI * (i + jitter(y * W + x, i)) / N;
+                sum = colorAdd(sum, trace((float)x / W, (float)y / H, cosf(a), sinf(a), 0));
+            }
+            out[0] = sum.r;
+            out[1] = sum.g;
+            out[2] = sum.b;
+        }
+}
+
+int transfer(int fd, void* buffer, size_t size, int writing) {
+    for (char* p = buffer; size > 0; ) {
+        ssize_t n = writing ? write(fd, p, size) : read(fd, p, size);
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    int workers = argc > 1 ? atoi(argv[1]) : 4, fds[MAX_WORKERS];
+    pid_t pids[MAX_WORKERS];
+    if (workers < 1 || workers > MAX_WORKERS || workers > N) {
+        fprintf(stderr, "usage: %s [workers (1-%d)]\n", argv[0], MAX_WORKERS);
+        return 1;
+    }
+
+    // Each worker renders a disjoint range of sample indices of the whole image
+    for (int k = 0; k < workers; k++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            perror("socketpair");
+            return 1;
+        }
+        if ((pids[k] = fork()) < 0) {
+            perror("fork");
+            return 1;
+        }
+        if (pids[k] == 0) {
+            close(sv[0]);
+            render(k * N / workers, (k + 1) * N / workers, part);
+            exit(transfer(sv[1], part, sizeof(part), 1) ? 0 : 1);
+        }
+        close(sv[1]);
+        fds[k] = sv[0];
+    }
+
+    // Merge in worker order so the result does not depend on completion order
+    for (int k = 0; k < workers; k++) {
+        int status;
+        if (!transfer(fds[k], part, sizeof(part), 0)) {
+            fprintf(stderr, "worker %d failed\n", k);
+            return 1;
+        }
+        close(fds[k]);
+        waitpid(pids[k], &status, 0);
+        for (int i = 0; i < W * H * 3; i++)
+            accum[i] += part[i];
+    }
+
+    unsigned char* p = img;
+    for (int i = 0; i < W * H * 3; i++, p++)
+        *p = (int)(fminf(accum[i] / N * 255.0f, 255.0f));
+    svpng(fopen("distributed.png", "wb"), W, H, img, 0);
+}
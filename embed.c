@@ -0,0 +1,86 @@
+#include <stdio.h> // printf(), fopen(), fwrite()
+#include <stdlib.h> // realloc(), free()
+
+// PNG output into a growable memory buffer instead of a file
+typedef struct { unsigned char* data; size_t size, capacity; } Buffer;
+
+void put(Buffer* b, unsigned char u) {
+    if (b->size == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 4096;
+        b->data = realloc(b->data, b->capacity);
+    }
+    b->data[b->size++] = u;
+}
+
+#define SVPNG_OUTPUT Buffer* buffer
+#define SVPNG_PUT(u) put(buffer, u)
+#define LIGHT2D_LINKAGE static
+#include "light2d.inc"
+
+#define W 512
+#define H 512
+#define N 64
+#define CANCEL_TILES 16         // Tiles after which the first render is cancelled
+
+// Scene parameters and render state of the caller, reached through the user pointer
+typedef struct { float theta; unsigned tiles; volatile int cancel; } Context;
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+Light2DResult unionOp(Light2DResult a, Light2DResult b) {
+    return a.sd < b.sd ? a : b;
+}
+
+// The scene of fresnel.c with the box rotated by the context
+Light2DResult scene(void* user, float x, float y) {
+    const Context* c = user;
+    Light2DResult a = { circleSDF(x, y, -0.2f, -0.2f, 0.1f), 10.0f, 0.0f, 0.0f };
+    Light2DResult b = {    boxSDF(x, y, 0.5f, 0.5f, c->theta, 0.3f, 0.2f), 0.0f, 0.2f, 1.5f };
+    return unionOp(a, b);
+}
+
+void tileDone(void* user, unsigned x, unsigned y, unsigned w, unsigned h) {
+    Context* c = user;
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)h;
+    if (++c->tiles == CANCEL_TILES)
+        c->cancel = 1;
+}
+
+// Renders through the library API into a caller-owned buffer, first
+// cancelling a render from its tile callback, then encoding a complete one
+// to PNG in memory. The file is only written to show the result.
+int main() {
+    static unsigned char img[W * H * 3];
+    Context c = { 0.1f, 0, 0 };
+    Light2D r = { .scene = scene, .user = &c, .w = W, .h = H, .n = N, .maxDepth = 3, .rgb = img, .tileDone = tileDone, .cancel = &c.cancel };
+    int complete = light2d(&r);
+    printf("first render %s after %u tiles\n", complete ? "completed" : "cancelled", c.tiles);
+
+    c.tiles = 0;
+    c.cancel = 0;
+    r.cancel = NULL;
+    complete = light2d(&r);
+    printf("second render %s after %u tiles\n", complete ? "completed" : "cancelled", c.tiles);
+
+    Buffer png = { NULL, 0, 0 };
+    svpng(&png, W, H, img, 0);
+    printf("%zu bytes of PNG in memory\n", png.size);
+    FILE* fp = fopen("embed.png", "wb");
+    fwrite(png.data, 1, png.size, fp);
+    fclose(fp);
+    free(png.data);
+}
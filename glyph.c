@@ -0,0 +1,343 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), floorf(), sinf(), cosf(), acosf(), cbrtf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <stdio.h> // sscanf()
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define MAX_GLYPH 8
+#define MAX_SEGMENT 32
+#define TILE_W 32               // Atlas tile of a glyph in texels
+#define TILE_H 48
+#define TEXEL 0.025f            // Texel size in em units
+#define PAD 0.1f                // Margin of a tile around the glyph box [0, width] x [0, 1] in em units
+#define REFINE (2.0f * TEXEL)   // Distance within which the exact outline distance is used
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+
+// Line from a to c, or quadratic Bezier with control point b
+typedef struct { int quad; float ax, ay, bx, by, cx, cy; } Segment;
+typedef struct { int n; float width; Segment s[MAX_SEGMENT]; } Glyph;
+
+// A string laid out in cells of advance em units from (x, y), with an em of size scene units
+typedef struct { const char* s; float x, y, size, advance; } Text;
+
+// Outlines in em units with y down: M x y, L x y, Q cx cy x y, Z. Filled by the even-odd rule.
+const struct { char c; const char* path; } font[] = {
+    { 'H', "M0 0 L.14 0 L.14 .43 L.46 .43 L.46 0 L.6 0 L.6 1 L.46 1 L.46 .57 L.14 .57 L.14 1 L0 1 Z" },
+    { 'E', "M0 0 L.55 0 L.55 .14 L.14 .14 L.14 .43 L.45 .43 L.45 .57 L.14 .57 L.14 .86 L.55 .86 L.55 1 L0 1 Z" },
+    { 'L', "M0 0 L.14 0 L.14 .86 L.55 .86 L.55 1 L0 1 Z" },
+    { 'O', "M.3 0 Q.6 0 .6 .5 Q.6 1 .3 1 Q0 1 0 .5 Q0 0 .3 0 Z M.3 .14 Q.46 .14 .46 .5 Q.46 .86 .3 .86 Q.14 .86 .14 .5 Q.14 .14 .3 .14 Z" },
+};
+
+unsigned char img[W * H * 3];
+Glyph glyphs[MAX_GLYPH];
+int glyphOf[128];
+float atlas[TILE_H][TILE_W * MAX_GLYPH];
+Text text = { "HELLO", 0.22f, 0.4f, 0.16f, 0.7f };
+
+void addSegment(Glyph* g, int quad, float ax, float ay, float bx, float by, float cx, float cy) {
+    Segment s = { quad, ax, ay, bx, by, cx, cy };
+    g->s[g->n++] = s;
+    g->width = fmaxf(g->width, fmaxf(ax, cx));
+}
+
+void parse(Glyph* g, const char* path) {
+    float x = 0.0f, y = 0.0f, sx = 0.0f, sy = 0.0f, bx, by, cx, cy;
+    int n;
+    for (char op; sscanf(path, " %c%n", &op, &n) == 1; ) {
+        path += n;
+        if (op == 'M' && sscanf(path, "%f %f%n", &x, &y, &n) == 2) {
+            sx = x;
+            sy = y;
+        }
+        else if (op == 'L' && sscanf(path, "%f %f%n", &cx, &cy, &n) == 2) {
+            addSegment(g, 0, x, y, x, y, cx, cy);
+            x = cx;
+            y = cy;
+        }
+        else if (op == 'Q' && sscanf(path, "%f %f %f %f%n", &bx, &by, &cx, &cy, &n) == 4) {
+            addSegment(g, 1, x, y, bx, by, cx, cy);
+            x = cx;
+            y = cy;
+        }
+        else if (op == 'Z') {
+            if (x != sx || y != sy)
+                addSegment(g, 0, x, y, x, y, sx, sy);
+            n = 0;
+        }
+        path += n;
+    }
+}
+
+float segmentDistance(const Segment* s, float x, float y) {
+    float vx = x - s->ax, vy = y - s->ay;
+    if (!s->quad) {
+        float ux = s->cx - s->ax, uy = s->cy - s->ay;
+        float t = fmaxf(fminf((vx * ux + vy * uy) / (ux * ux + uy * uy), 1.0f), 0.0f);
+        float dx = vx - ux * t, dy = vy - uy * t;
+        return sqrtf(dx * dx + dy * dy);
+    }
+    // Closest point on a quadratic Bezier from the roots of a cubic (Quilez)
+    float ax = s->bx - s->ax, ay = s->by - s->ay;
+    float bx = s->ax - 2.0f * s->bx + s->cx, by = s->ay - 2.0f * s->by + s->cy;
+    float kk = 1.0f / (bx * bx + by * by);
+    float kx = kk * (ax * bx + ay * by);
+    float ky = kk * (2.0f * (ax * ax + ay * ay) - (vx * bx + vy * by)) / 3.0f;
+    float kz = kk * -(vx * ax + vy * ay);
+    float p = ky - kx * kx, q = kx * (2.0f * kx * kx - 3.0f * ky) + kz, h = q * q + 4.0f * p * p * p;
+    float t[3];
+    int n;
+    if (h >= 0.0f) {
+        h = sqrtf(h);
+        t[0] = cbrtf((h - q) * 0.5f) + cbrtf((-h - q) * 0.5f) - kx;
+        n = 1;
+    }
+    else {
+        float z = sqrtf(-p), v = acosf(q / (p * z * 2.0f)) / 3.0f, m = cosf(v), k = sinf(v) * 1.732050808f;
+        t[0] = (m + m) * z - kx;
+        t[1] = (-k - m) * z - kx;
+        n = 2;
+    }
+    float d = MAX_DISTANCE;
+    for (int i = 0; i < n; i++) {
+        float u = fmaxf(fminf(t[i], 1.0f), 0.0f);
+        float dx = (2.0f * ax + bx * u) * u - vx, dy = (2.0f * ay + by * u) * u - vy;
+        d = fminf(d, sqrtf(dx * dx + dy * dy));
+    }
+    return d;
+}
+
+// Number of crossings of the ray from (x, y) towards +x with a segment
+int crossings(const Segment* s, float x, float y) {
+    if (!s->quad) {
+        if ((s->ay > y) == (s->cy > y))
+            return 0;
+        return x < s->ax + (y - s->ay) * (s->cx - s->ax) / (s->cy - s->ay);
+    }
+    // Roots of ay + 2 (by - ay) t + (ay - 2 by + cy) t^2 = y in [0, 1)
+    float a = s->ay - 2.0f * s->by + s->cy, b = 2.0f * (s->by - s->ay), c = s->ay - y, t[2];
+    int n = 0, count = 0;
+    if (fabsf(a) < 1e-8f) {
+        if (b != 0.0f)
+            t[n++] = -c / b;
+    }
+    else {
+        float d = b * b - 4.0f * a * c;
+        if (d >= 0.0f) {
+            t[n++] = (-b - sqrtf(d)) / (2.0f * a);
+            t[n++] = (-b + sqrtf(d)) / (2.0f * a);
+        }
+    }
+    for (int i = 0; i < n; i++)
+        if (t[i] >= 0.0f && t[i] < 1.0f) {
+            float u = 1.0f - t[i];
+            count += x < u * u * s->ax + 2.0f * u * t[i] * s->bx + t[i] * t[i] * s->cx;
+        }
+    return count;
+}
+
+// Exact signed distance to a glyph outline in em units
+float glyphSDF(const Glyph* g, float x, float y) {
+    float d = MAX_DISTANCE;
+    int count = 0;
+    for (int i = 0; i < g->n; i++) {
+        d = fminf(d, segmentDistance(&g->s[i], x, y));
+        count += crossings(&g->s[i], x, y);
+    }
+    return count & 1 ? -d : d;
+}
+
+void load() {
+    for (int c = 0; c < 128; c++)
+        glyphOf[c] = -1;
+    for (int k = 0; k < (int)(sizeof(font) / sizeof(font[0])); k++) {
+        Glyph* g = &glyphs[k];
+        glyphOf[(int)font[k].c] = k;
+        parse(g, font[k].path);
+        for (int j = 0; j < TILE_H; j++)
+            for (int i = 0; i < TILE_W; i++)
+                atlas[j][k * TILE_W + i] = glyphSDF(g, i * TEXEL - PAD, j * TEXEL - PAD);
+    }
+}
+
+// Distance to a glyph in em units, from its atlas tile by bilinear interpolation.
+// The interpolation may overestimate by up to a texel, which is subtracted;
+// near the outline the exact distance is computed instead. Outside the tile
+// the distance to the glyph box is a lower bound.
+float atlasSDF(int k, float x, float y) {
+    float u = (x + PAD) / TEXEL, v = (y + PAD) / TEXEL;
+    if (u < 0.0f || v < 0.0f || u >= TILE_W - 1 || v >= TILE_H - 1) {
+        float dx = fmaxf(fmaxf(-x, x - glyphs[k].width), 0.0f), dy = fmaxf(fmaxf(-y, y - 1.0f), 0.0f);
+        return sqrtf(dx * dx + dy * dy);
+    }
+    int i = (int)u, j = (int)v;
+    float fu = u - i, fv = v - j;
+    const float* a = &atlas[j][k * TILE_W + i], * b = &atlas[j + 1][k * TILE_W + i];
+    float d = (a[0] * (1.0f - fu) + a[1] * fu) * (1.0f - fv) + (b[0] * (1.0f - fu) + b[1] * fu) * fv;
+    return d < REFINE ? glyphSDF(&glyphs[k], x, y) : d - TEXEL;
+}
+
+// Each glyph lies within its own cell, so only the cell of the point and its
+// neighbors are looked up. Glyphs further away are bounded by the gap to them.
+float textSDF(const Text* t, float x, float y) {
+    float u = (x - t->x) / t->size, v = (y - t->y) / t->size;
+    int i = (int)floorf(u / t->advance), n = 0;
+    while (t->s[n])
+        n++;
+    float gy = fmaxf(fmaxf(-v, v - 1.0f), 0.0f), gx = MAX_DISTANCE;
+    if (i - 2 >= 0)
+        gx = fminf(gx, u - (i - 1) * t->advance);
+    if (i + 2 < n)
+        gx = fminf(gx, (i + 2) * t->advance - u);
+    float d = sqrtf(gx * gx + gy * gy);
+    for (int k = i - 1; k <= i + 1; k++)
+        if (k >= 0 && k < n && glyphOf[(int)t->s[k]] >= 0)
+            d = fminf(d, atlasSDF(glyphOf[(int)t->s[k]], u - k * t->advance, v));
+    return d * t->size;
+}
+
+// The same text from the exact outlines of all glyphs, for comparison
+float exactTextSDF(const Text* t, float x, float y) {
+    float u = (x - t->x) / t->size, v = (y - t->y) / t->size, d = MAX_DISTANCE;
+    for (int k = 0; t->s[k]; k++)
+        if (glyphOf[(int)t->s[k]] >= 0)
+            d = fminf(d, glyphSDF(&glyphs[glyphOf[(int)t->s[k]]], u - k * t->advance, v));
+    return d * t->size;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, -0.2f, 0.1f), 10.0f, 0.0f, 0.0f };
+    Result b = { textSDF(&text, x, y), 0.0f, 0.2f, 1.5f };
+    // Result b = { textSDF(&text, x, y), 2.0f, 0.0f, 0.0f };
+    return unionOp(a, b);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float schlick(float cosi, float cost, float etai, float etat) {
+    float r0 = (etai - etat) / (etai + etat);
+    r0 *= r0;
+    float a = 1.0f - (etai < etat ? cosi : cost);
+    float aa = a * a;
+    return r0 + (1.0f - r0) * aa * aa * a;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        // refl = sign < 0.0f ? schlick(cosi, cost, r.eta, 1.0f) : schlick(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum / N;
+}
+
+// Time atlas and exact text distances over the image, and their largest
+// difference within a texel of the outlines, where the marching hits
+void compare() {
+    float maxError = 0.0f, sum[2] = { 0.0f, 0.0f };
+    for (int k = 0; k < 2; k++) {
+        clock_t start = clock();
+        for (int y = 0; y < H; y++)
+            for (int x = 0; x < W; x++)
+                sum[k] += k ? exactTextSDF(&text, (float)x / W, (float)y / H) : textSDF(&text, (float)x / W, (float)y / H);
+        printf("%-6s %.3fs\n", k ? "exact" : "atlas", (double)(clock() - start) / CLOCKS_PER_SEC);
+    }
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            float d = exactTextSDF(&text, (float)x / W, (float)y / H);
+            if (fabsf(d) < TEXEL * text.size)
+                maxError = fmaxf(maxError, fabsf(textSDF(&text, (float)x / W, (float)y / H) - d));
+        }
+    printf("max error near outlines %g\n", maxError);
+}
+
+int main() {
+    load();
+    compare();
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("glyph.png", "wb"), W, H, img, 0);
+}
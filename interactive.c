@@ -0,0 +1,279 @@
+#include <stdio.h> // sscanf(), sprintf(), fprintf()
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <string.h> // strlen(), strncmp(), memcpy(), memset()
+#include <fcntl.h> // open()
+#include <unistd.h> // read(), ftruncate(), close()
+#include <sys/mman.h> // mmap(), msync(), munmap()
+#include <sys/select.h> // select()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256                   // Samples per pixel at convergence
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define TILE 32
+#define TILES ((W / TILE) * (H / TILE))
+#define SLOTS 4                 // Accumulations kept for recent scene parameters
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+
+// Scene parameters edited from stdin
+float lightX = 0.5f, lightY = -0.5f, eta = 1.5f;
+unsigned char* frame;
+
+// Accumulation of a set of scene parameters, with the samples per pixel of
+// each tile. Returning to recently edited parameters resumes their samples.
+typedef struct { float lightX, lightY, eta; int used, count[TILES]; float accum[W * H]; } Slot;
+Slot slots[SLOTS];
+Slot* current;
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, lightX, lightY, 0.05f), 20.0f, 0.0f, 0.0f };
+    Result b = { circleSDF(x, y, 0.5f, 0.2f, 0.35f), 0.0f, 0.2f, eta };
+    Result c = { circleSDF(x, y, 0.5f, 0.8f, 0.35f), 0.0f, 0.2f, eta };
+    return unionOp(a, intersectOp(b, c));
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float schlick(float cosi, float cost, float etai, float etat) {
+    float r0 = (etai - etat) / (etai + etat);
+    r0 *= r0;
+    float a = 1.0f - (etai < etat ? cosi : cost);
+    float aa = a * a;
+    return r0 + (1.0f - r0) * aa * aa * a;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        // refl = sign < 0.0f ? schlick(cosi, cost, r.eta, 1.0f) : schlick(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+float sample(float x, float y, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / n;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum;
+}
+
+// Returns 1 if the scene changed, -1 to quit
+int command(const char* line) {
+    float a, b;
+    if (sscanf(line, "light %f %f", &a, &b) == 2) {
+        lightX = a;
+        lightY = b;
+        return 1;
+    }
+    if (sscanf(line, "eta %f", &a) == 1) {
+        eta = a;
+        return 1;
+    }
+    if (strncmp(line, "quit", 4) == 0)
+        return -1;
+    fprintf(stderr, "unknown command: %s\n", line);
+    return 0;
+}
+
+// Apply the commands available on stdin without blocking, or wait for one if
+// idle. Returns 1 if the scene changed, -1 to quit, which is also the case
+// when idle and stdin is closed.
+int readCommands(int idle) {
+    static char line[256];
+    static int length, closed;
+    int changed = 0;
+    while (!closed) {
+        struct timeval zero = { 0, 0 };
+        fd_set fds;
+        char c;
+        FD_ZERO(&fds);
+        FD_SET(0, &fds);
+        if (select(1, &fds, NULL, NULL, idle && !changed ? NULL : &zero) <= 0)
+            break;
+        if (read(0, &c, 1) <= 0)
+            closed = 1;
+        else if (c != '\n' && length < (int)sizeof(line) - 1)
+            line[length++] = c;
+        else {
+            int r;
+            line[length] = '\0';
+            length = 0;
+            if ((r = command(line)) < 0)
+                return -1;
+            changed |= r;
+        }
+    }
+    return closed && idle && !changed ? -1 : changed;
+}
+
+void show(int tx, int ty) {
+    int k = ty * (W / TILE) + tx;
+    for (int y = ty * TILE; y < (ty + 1) * TILE; y++)
+        for (int x = tx * TILE; x < (tx + 1) * TILE; x++)
+            frame[(y * W + x) * 3] = frame[(y * W + x) * 3 + 1] = frame[(y * W + x) * 3 + 2] =
+                (int)(fminf(current->accum[y * W + x] / current->count[k] * 255.0f, 255.0f));
+}
+
+// Add n samples to each pixel of a tile, and show the mean of all its samples
+void render(int tx, int ty, int n) {
+    int k = ty * (W / TILE) + tx;
+    for (int y = ty * TILE; y < (ty + 1) * TILE; y++)
+        for (int x = tx * TILE; x < (tx + 1) * TILE; x++) {
+            float c = sample((float)x / W, (float)y / H, n);
+            current->accum[y * W + x] = current->count[k] ? current->accum[y * W + x] + c : c;
+        }
+    current->count[k] += n;
+    show(tx, ty);
+}
+
+// Switch to the accumulation of the current parameters, or recycle the least
+// recently used one, and show the tiles that already have samples
+void activate(int time) {
+    Slot* s = &slots[0];
+    for (int i = 0; i < SLOTS; i++) {
+        Slot* t = &slots[i];
+        if (t->used && t->lightX == lightX && t->lightY == lightY && t->eta == eta) {
+            s = t;
+            break;
+        }
+        if (t->used < s->used)
+            s = t;
+    }
+    if (!s->used || s->lightX != lightX || s->lightY != lightY || s->eta != eta) {
+        s->lightX = lightX;
+        s->lightY = lightY;
+        s->eta = eta;
+        memset(s->count, 0, sizeof(s->count));
+    }
+    s->used = time;
+    current = s;
+    for (int k = 0; k < TILES; k++)
+        if (current->count[k] > 0)
+            show(k % (W / TILE), k / (W / TILE));
+}
+
+// Progressively render into interactive.ppm, a file shared with a viewer
+// through mmap(). The tile with the fewest samples, which is at s, gets s
+// more up to N, so passes double the samples per pixel. Commands on stdin
+// (light x y, eta v, quit) are checked between tiles. A scene change
+// switches to the accumulation of the new parameters, which starts from one
+// sample per pixel unless they were among the last SLOTS ones, and tiles
+// rendered before a cancellation keep their samples. The old image stays
+// visible until its tiles are overwritten.
+int main() {
+    char header[32];
+    sprintf(header, "P6\n%d %d\n255\n", W, H);
+    size_t size = strlen(header) + W * H * 3;
+    int fd = open("interactive.ppm", O_RDWR | O_CREAT, 0644);
+    unsigned char* map;
+    if (fd < 0 || ftruncate(fd, size) < 0 || (map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+        perror("interactive.ppm");
+        return 1;
+    }
+    memcpy(map, header, strlen(header));
+    frame = map + strlen(header);
+
+    int time = 1, converged = 0;
+    activate(time);
+    for (int r = 0; r >= 0; ) {
+        int k = 0;
+        for (int i = 1; i < TILES; i++)
+            if (current->count[i] < current->count[k])
+                k = i;
+        int s = current->count[k];
+        if (s == N) {
+            if (!converged)
+                fprintf(stderr, "converged at %d samples per pixel\n", s);
+            converged = 1;
+            msync(map, size, MS_ASYNC);
+            r = readCommands(1);
+        }
+        else {
+            render(k % (W / TILE), k / (W / TILE), s > 0 ? (s < N - s ? s : N - s) : 1);
+            r = readCommands(0);
+        }
+        if (r > 0) {
+            activate(++time);
+            converged = 0;
+        }
+    }
+    munmap(map, size);
+    close(fd);
+}
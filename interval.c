@@ -0,0 +1,256 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrtf()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 2.0f
+#define EPSILON 1e-6f
+#define START 1e-3f             // Distance of the first step of csg.c, the largest of the samples
+#define TILE 8
+#define SCENES 4
+#define UNKNOWN -1.0f           // Emission of a range that may hold several materials
+
+typedef struct { float sd, emissive; } Result;
+typedef struct { float lo, hi; } Interval;
+// Bounds of the distance over a region and the emission there, if it is unique
+typedef struct { Interval sd; float emissive; } Range;
+typedef struct { const char* name; Result (*scene)(float, float); Range (*range)(Interval, Interval); } Scene;
+
+unsigned char img[H * W * SCENES * 3];
+
+Interval interval(float lo, float hi) {
+    Interval a = { lo, hi };
+    return a;
+}
+
+Interval iadd(Interval a, Interval b) {
+    return interval(a.lo + b.lo, a.hi + b.hi);
+}
+
+Interval isub(Interval a, float b) {
+    return interval(a.lo - b, a.hi - b);
+}
+
+Interval iscale(Interval a, float s) {
+    return s >= 0.0f ? interval(a.lo * s, a.hi * s) : interval(a.hi * s, a.lo * s);
+}
+
+Interval isquare(Interval a) {
+    if (a.lo >= 0.0f)
+        return interval(a.lo * a.lo, a.hi * a.hi);
+    if (a.hi <= 0.0f)
+        return interval(a.hi * a.hi, a.lo * a.lo);
+    return interval(0.0f, fmaxf(a.lo * a.lo, a.hi * a.hi));
+}
+
+Interval isqrt(Interval a) {
+    return interval(sqrtf(a.lo), sqrtf(a.hi));
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Interval circleInterval(Interval x, Interval y, float cx, float cy, float r) {
+    return isub(isqrt(iadd(isquare(isub(x, cx)), isquare(isub(y, cy)))), r);
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+Interval planeInterval(Interval x, Interval y, float px, float py, float nx, float ny) {
+    return iadd(iscale(isub(x, px), nx), iscale(isub(y, py), ny));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+// Either operand wins where its distance is certainly smaller. Otherwise
+// the emission is only known when both operands share it.
+Range unionRange(Range a, Range b) {
+    if (a.sd.hi < b.sd.lo)
+        return a;
+    if (b.sd.hi < a.sd.lo)
+        return b;
+    Range r = { interval(fminf(a.sd.lo, b.sd.lo), fminf(a.sd.hi, b.sd.hi)), a.emissive == b.emissive ? a.emissive : UNKNOWN };
+    return r;
+}
+
+// The intersection of shapes.c, which keeps the material of the farther operand
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Range intersectRange(Range a, Range b) {
+    if (a.sd.lo > b.sd.hi)
+        return a;
+    if (b.sd.lo > a.sd.hi)
+        return b;
+    Range r = { interval(fmaxf(a.sd.lo, b.sd.lo), fmaxf(a.sd.hi, b.sd.hi)), a.emissive == b.emissive ? a.emissive : UNKNOWN };
+    return r;
+}
+
+Range range(Interval sd, float emissive) {
+    Range r = { sd, emissive };
+    return r;
+}
+
+// The scenes of basic.c, both scenes of csg.c and shapes.c, each with an
+// interval version that mirrors the expression of the point version.
+Result basicScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, 0.5f, 0.1f), 2.0f };
+    return a;
+}
+
+Range basicRange(Interval x, Interval y) {
+    return range(circleInterval(x, y, 0.5f, 0.5f, 0.1f), 2.0f);
+}
+
+Result csgScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.4f, 0.5f, 0.20f), 1.0f };
+    Result b = { circleSDF(x, y, 0.6f, 0.5f, 0.20f), 0.8f };
+    return unionOp(a, b);
+}
+
+Range csgRange(Interval x, Interval y) {
+    Range a = range(circleInterval(x, y, 0.4f, 0.5f, 0.20f), 1.0f);
+    Range b = range(circleInterval(x, y, 0.6f, 0.5f, 0.20f), 0.8f);
+    return unionRange(a, b);
+}
+
+Result occluderScene(float x, float y) {
+    Result r1 = { circleSDF(x, y, 0.3f, 0.3f, 0.10f), 2.0f };
+    Result r2 = { circleSDF(x, y, 0.3f, 0.7f, 0.05f), 0.8f };
+    Result r3 = { circleSDF(x, y, 0.7f, 0.5f, 0.10f), 0.0f };
+    return unionOp(unionOp(r1, r2), r3);
+}
+
+Range occluderRange(Interval x, Interval y) {
+    Range r1 = range(circleInterval(x, y, 0.3f, 0.3f, 0.10f), 2.0f);
+    Range r2 = range(circleInterval(x, y, 0.3f, 0.7f, 0.05f), 0.8f);
+    Range r3 = range(circleInterval(x, y, 0.7f, 0.5f, 0.10f), 0.0f);
+    return unionRange(unionRange(r1, r2), r3);
+}
+
+Result shapesScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, 0.5f, 0.2f), 1.0f };
+    Result b = {  planeSDF(x, y, 0.0f, 0.5f, 0.0f, 1.0f), 0.8f };
+    return intersectOp(a, b);
+}
+
+Range shapesRange(Interval x, Interval y) {
+    Range a = range(circleInterval(x, y, 0.5f, 0.5f, 0.2f), 1.0f);
+    Range b = range( planeInterval(x, y, 0.0f, 0.5f, 0.0f, 1.0f), 0.8f);
+    return intersectRange(a, b);
+}
+
+const Scene scenes[SCENES] = {
+    { "basic", basicScene, basicRange },
+    { "csg", csgScene, csgRange },
+    { "csg occluder", occluderScene, occluderRange },
+    { "shapes", shapesScene, shapesRange },
+};
+
+float trace(Result (*scene)(float, float), float ox, float oy, float dx, float dy) {
+    float t = START;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        Result r = scene(ox + dx * t, oy + dy * t);
+        if (r.sd < EPSILON)
+            return r.emissive;
+        t += r.sd;
+    }
+    return 0.0f;
+}
+
+float sample(Result (*scene)(float, float), float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += trace(scene, x, y, cosf(a), sinf(a));
+    }
+    return sum / N;
+}
+
+// A tile is proven constant when the first step of every ray from its
+// pixels, which lies within START of them, is certainly inside the scene and
+// the material there is unique. Every ray then returns that emission, which
+// is a solid emitter or black for an opaque non-emitter.
+int prove(const Scene* s, int tx, int ty, float* emissive) {
+    Interval x = interval((float)(tx * TILE) / W - START, (float)(tx * TILE + TILE - 1) / W + START);
+    Interval y = interval((float)(ty * TILE) / H - START, (float)(ty * TILE + TILE - 1) / H + START);
+    Range r = s->range(x, y);
+    *emissive = r.emissive;
+    return r.sd.hi < EPSILON && r.emissive != UNKNOWN;
+}
+
+void put(int i, int x, int y, float v) {
+    unsigned char* p = img + (y * W * SCENES + i * W + x) * 3;
+    p[0] = p[1] = p[2] = (int)(fminf(v * 255.0f, 255.0f));
+}
+
+// The radiance N equal samples average to, so that a fill matches tracing exactly
+float fill(float emissive) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++)
+        sum += emissive;
+    return sum / N;
+}
+
+// Renders a scene into its panel, with or without the pre-pass, and returns
+// the seconds taken
+double render(int i, int prepass, int* emitters, int* blacks) {
+    const Scene* s = &scenes[i];
+    clock_t start = clock();
+    *emitters = *blacks = 0;
+    srand(1);
+    for (int ty = 0; ty < H / TILE; ty++)
+        for (int tx = 0; tx < W / TILE; tx++) {
+            float emissive;
+            if (prepass && prove(s, tx, ty, &emissive)) {
+                for (int y = ty * TILE; y < ty * TILE + TILE; y++)
+                    for (int x = tx * TILE; x < tx * TILE + TILE; x++)
+                        put(i, x, y, fill(emissive));
+                (*(emissive > 0.0f ? emitters : blacks))++;
+            }
+            else
+                for (int y = ty * TILE; y < ty * TILE + TILE; y++)
+                    for (int x = tx * TILE; x < tx * TILE + TILE; x++)
+                        put(i, x, y, sample(s->scene, (float)x / W, (float)y / H));
+        }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Each proven tile is traced again to confirm that the fill matches
+int verify(int i) {
+    const Scene* s = &scenes[i];
+    int mismatches = 0;
+    for (int ty = 0; ty < H / TILE; ty++)
+        for (int tx = 0; tx < W / TILE; tx++) {
+            float emissive;
+            if (prove(s, tx, ty, &emissive))
+                for (int y = ty * TILE; y < ty * TILE + TILE; y++)
+                    for (int x = tx * TILE; x < tx * TILE + TILE; x++)
+                        mismatches += sample(s->scene, (float)x / W, (float)y / H) != fill(emissive);
+        }
+    return mismatches;
+}
+
+int main() {
+    int tiles = (W / TILE) * (H / TILE);
+    printf("%-14s %13s %13s %9s %9s %11s\n", "scene", "emitter tiles", "black tiles", "traced", "pre-pass", "mismatches");
+    for (int i = 0; i < SCENES; i++) {
+        int emitters, blacks;
+        double traced = render(i, 0, &emitters, &blacks);
+        double skipped = render(i, 1, &emitters, &blacks);
+        printf("%-14s %6d/%-6d %6d/%-6d %8.3fs %8.3fs %11d\n", scenes[i].name, emitters, tiles, blacks, tiles, traced, skipped, verify(i));
+    }
+    svpng(fopen("interval.png", "wb"), W * SCENES, H, img, 0);
+}
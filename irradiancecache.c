@@ -0,0 +1,149 @@
+#include "svpng.inc"
+#include <math.h> // fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 2.0f
+#define EPSILON 1e-6f
+#define ALPHA 0.5f              // Scale of validity radius relative to harmonic mean distance
+#define TOLERANCE 0.02f         // Allowed first order change of irradiance within a record
+#define MIN_RADIUS (1.5f / W)
+#define MAX_RADIUS (32.0f / W)
+#define MIN_WEIGHT 0.3f
+#define MAX_RECORDS 32768
+#define GRID 32
+#define MAX_NODES (MAX_RECORDS * 25)
+
+typedef struct { float sd, emissive; } Result;
+typedef struct { float x, y, e, gx, gy, r; } Record;
+
+unsigned char img[W * H * 3];
+Record records[MAX_RECORDS];
+int recordCount, directCount;
+int cellHead[GRID * GRID], nodeRecord[MAX_NODES], nodeNext[MAX_NODES], nodeCount;
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result r1 = { circleSDF(x, y, 0.3f, 0.3f, 0.10f), 2.0f };
+    Result r2 = { circleSDF(x, y, 0.3f, 0.7f, 0.05f), 0.8f };
+    Result r3 = { circleSDF(x, y, 0.7f, 0.5f, 0.10f), 0.0f };
+    return unionOp(unionOp(r1, r2), r3);
+}
+
+float trace(float ox, float oy, float dx, float dy, float* distance) {
+    float t = 0.001f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        Result r = scene(ox + dx * t, oy + dy * t);
+        if (r.sd < EPSILON) {
+            *distance = t;
+            return r.emissive;
+        }
+        t += r.sd;
+    }
+    *distance = MAX_DISTANCE;
+    return 0.0f;
+}
+
+// Trace the angular radiance at (x, y) and turn it into an irradiance record.
+// The translational gradient accounts for the shift of each boundary between
+// adjacent angular bins, which moves by -(d . u_perp) / r for a displacement d.
+// Returns the irradiance, which is still valid when the cache is full.
+float addRecord(float x, float y) {
+    float L[N], t[N], e = 0.0f, gx = 0.0f, gy = 0.0f, invDistance = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        L[i] = trace(x, y, cosf(a), sinf(a), &t[i]);
+        e += L[i];
+        invDistance += 1.0f / t[i];
+    }
+    for (int i = 0; i < N; i++) {
+        int j = (i + 1) % N;
+        float a = TWO_PI * (i + 1) / N, r = fminf(t[i], t[j]);
+        float s = (L[j] - L[i]) / (TWO_PI * r);
+        gx -= sinf(a) * s;
+        gy += cosf(a) * s;
+    }
+    float g = sqrtf(gx * gx + gy * gy);
+    float radius = ALPHA * N / invDistance;
+    if (g > 0.0f)
+        radius = fminf(radius, TOLERANCE / g);
+    radius = fmaxf(fminf(radius, MAX_RADIUS), MIN_RADIUS);
+
+    if (recordCount == MAX_RECORDS)
+        return e / N;
+    Record* rec = &records[recordCount];
+    rec->x = x;
+    rec->y = y;
+    rec->e = e / N;
+    rec->gx = gx;
+    rec->gy = gy;
+    rec->r = radius;
+    int x0 = (int)fmaxf((x - radius) * GRID, 0.0f), x1 = (int)fminf((x + radius) * GRID, GRID - 1);
+    int y0 = (int)fmaxf((y - radius) * GRID, 0.0f), y1 = (int)fminf((y + radius) * GRID, GRID - 1);
+    for (int cy = y0; cy <= y1; cy++)
+        for (int cx = x0; cx <= x1; cx++)
+            if (nodeCount < MAX_NODES) {
+                nodeRecord[nodeCount] = recordCount;
+                nodeNext[nodeCount] = cellHead[cy * GRID + cx];
+                cellHead[cy * GRID + cx] = nodeCount++;
+            }
+    recordCount++;
+    return e / N;
+}
+
+// Weighted extrapolation of nearby records, returns total weight
+float lookup(float x, float y, float* e) {
+    float sum = 0.0f, weight = 0.0f;
+    int cx = (int)fminf(x * GRID, GRID - 1), cy = (int)fminf(y * GRID, GRID - 1);
+    for (int n = cellHead[cy * GRID + cx]; n >= 0; n = nodeNext[n]) {
+        const Record* rec = &records[nodeRecord[n]];
+        float ux = x - rec->x, uy = y - rec->y;
+        float w = 1.0f - sqrtf(ux * ux + uy * uy) / rec->r;
+        if (w > 0.0f) {
+            sum += w * (rec->e + rec->gx * ux + rec->gy * uy);
+            weight += w;
+        }
+    }
+    *e = weight > 0.0f ? fmaxf(sum / weight, 0.0f) : 0.0f;
+    return weight;
+}
+
+float sample(float x, float y) {
+    float e;
+    Result r = scene(x, y);
+    if (r.sd < 0.0f)
+        return r.emissive; // Every direction starts inside the same object
+    if (lookup(x, y, &e) < MIN_WEIGHT) {
+        float direct = addRecord(x, y);
+        if (lookup(x, y, &e) < MIN_WEIGHT) {
+            directCount++; // The cache is saturated, keep the sampled irradiance
+            return direct;
+        }
+    }
+    return e;
+}
+
+int main() {
+    for (int i = 0; i < GRID * GRID; i++)
+        cellHead[i] = -1;
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    printf("%d records for %d pixels (%.1f%%)\n", recordCount, W * H, 100.0f * recordCount / (W * H));
+    if (directCount)
+        printf("cache saturated, %d pixels sampled directly\n", directCount);
+    svpng(fopen("irradiancecache.png", "wb"), W, H, img, 0);
+}
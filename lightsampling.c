@@ -0,0 +1,160 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), asinf(), atan2f(), fmodf()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define PI 3.14159265359f
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N_UNIFORM 32
+#define N_LIGHT 32
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define LIGHT_COUNT (sizeof(lights) / sizeof(lights[0]))
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+typedef struct { float cx, cy, r, emissive; } Light;
+
+unsigned char img[W * H * 3];
+
+// Emissive circles known to the sampler, also used by scene()
+const Light lights[] = {
+    { 0.5f, -0.5f, 0.05f, 20.0f }
+};
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result c = { circleSDF(x, y, lights[0].cx, lights[0].cy, lights[0].r), lights[0].emissive, 0.0f, 0.0f };
+    Result d = { circleSDF(x, y, 0.5f, 0.2f, 0.35f), 0.0f, 0.2f, 1.5f };
+    Result e = { circleSDF(x, y, 0.5f, 0.8f, 0.35f), 0.0f, 0.2f, 1.5f };
+    return unionOp(c, intersectOp(d, e));
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+// Center angle and half angle of the cone subtended by a light at (x, y)
+void lightCone(const Light* l, float x, float y, float* center, float* half) {
+    float ux = l->cx - x, uy = l->cy - y, d = sqrtf(ux * ux + uy * uy);
+    *center = atan2f(uy, ux);
+    *half = d > l->r ? asinf(l->r / d) : PI;
+}
+
+// Density of choosing angle a by picking a light uniformly then its cone uniformly
+float lightPdf(float x, float y, float a) {
+    float pdf = 0.0f;
+    for (unsigned l = 0; l < LIGHT_COUNT; l++) {
+        float center, half;
+        lightCone(&lights[l], x, y, &center, &half);
+        float diff = fabsf(fmodf(a - center + 3.0f * PI, TWO_PI) - PI);
+        if (diff <= half)
+            pdf += 1.0f / (2.0f * half);
+    }
+    return pdf / LIGHT_COUNT;
+}
+
+// Multi-sample MIS with the balance heuristic: sum of f / (n_u * p_u + n_l * p_l)
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N_UNIFORM; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N_UNIFORM;
+        float f = trace(x, y, cosf(a), sinf(a), 0);
+        if (f > 0.0f)
+            sum += f / (N_UNIFORM / TWO_PI + N_LIGHT * lightPdf(x, y, a));
+    }
+    for (int i = 0; i < N_LIGHT; i++) {
+        float center, half;
+        lightCone(&lights[i % LIGHT_COUNT], x, y, &center, &half);
+        int strata = (N_LIGHT + LIGHT_COUNT - 1 - i % LIGHT_COUNT) / LIGHT_COUNT;
+        float u = (i / LIGHT_COUNT + (float)rand() / RAND_MAX) / strata;
+        float a = center + (2.0f * u - 1.0f) * half;
+        float f = trace(x, y, cosf(a), sinf(a), 0);
+        if (f > 0.0f)
+            sum += f / (N_UNIFORM / TWO_PI + N_LIGHT * lightPdf(x, y, a));
+    }
+    return sum / TWO_PI;
+}
+
+int main() {
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("lightsampling.png", "wb"), W, H, img, 0);
+}
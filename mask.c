@@ -0,0 +1,266 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <stdio.h> // fopen(), fscanf(), fread()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define MAX_MASK 1024
+#define MASK_X0 0.2f            // Square of the scene covered by the mask
+#define MASK_Y0 0.2f
+#define MASK_SIZE 0.6f
+#define INF 1e20f
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+
+unsigned char img[W * H * 3];
+int maskW, maskH;
+float coverage[MAX_MASK * MAX_MASK], field[MAX_MASK * MAX_MASK];
+
+// Reads a binary PGM (P5) with 8-bit samples as coverage in [0, 1]
+int loadPGM(const char* filename) {
+    FILE* fp = fopen(filename, "rb");
+    int maxval, c;
+    if (!fp)
+        return 0;
+    if (fgetc(fp) != 'P' || fgetc(fp) != '5') {
+        fclose(fp);
+        return 0;
+    }
+    int values[3];
+    for (int k = 0; k < 3; k++) {
+        while ((c = fgetc(fp)) == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            if (c == '#')
+                while ((c = fgetc(fp)) != '\n' && c != EOF);
+        ungetc(c, fp);
+        if (fscanf(fp, "%d", &values[k]) != 1) {
+            fclose(fp);
+            return 0;
+        }
+    }
+    fgetc(fp); // Single whitespace before the samples
+    maskW = values[0];
+    maskH = values[1];
+    maxval = values[2];
+    if (maskW <= 0 || maskH <= 0 || maskW > MAX_MASK || maskH > MAX_MASK || maxval <= 0 || maxval > 255) {
+        fclose(fp);
+        return 0;
+    }
+    for (int i = 0; i < maskW * maskH; i++)
+        coverage[i] = (c = fgetc(fp)) == EOF ? 0.0f : (float)c / maxval;
+    fclose(fp);
+    return 1;
+}
+
+// Anti-aliased crescent and diamond by 4x4 supersampling, used without a mask file
+void proceduralMask() {
+    maskW = maskH = 256;
+    for (int y = 0; y < maskH; y++)
+        for (int x = 0; x < maskW; x++) {
+            int inside = 0;
+            for (int j = 0; j < 4; j++)
+                for (int i = 0; i < 4; i++) {
+                    float u = (x + (i + 0.5f) / 4) / maskW, v = (y + (j + 0.5f) / 4) / maskH;
+                    float a = (u - 0.35f) * (u - 0.35f) + (v - 0.4f) * (v - 0.4f), b = (u - 0.45f) * (u - 0.45f) + (v - 0.33f) * (v - 0.33f);
+                    float s = fabsf(u - 0.7f) + fabsf(v - 0.7f);
+                    inside += (a < 0.3f * 0.3f && b > 0.25f * 0.25f) || s < 0.18f;
+                }
+            coverage[y * maskW + x] = inside / 16.0f;
+        }
+}
+
+// Squared Euclidean distance transform of n samples with stride (Felzenszwalb and
+// Huttenlocher 2012), the lower envelope of parabolas rooted at f[q] in linear time
+void edt(float* f, int n, int stride) {
+    static float d[MAX_MASK], z[MAX_MASK + 1], g[MAX_MASK];
+    static int v[MAX_MASK];
+    int k = 0;
+    for (int q = 0; q < n; q++)
+        g[q] = f[q * stride];
+    v[0] = 0;
+    z[0] = -INF;
+    z[1] = INF;
+    for (int q = 1; q < n; q++) {
+        if (g[q] >= INF)
+            continue;
+        float s;
+        while (k >= 0 && (g[v[k]] >= INF || (s = ((g[q] + q * q) - (g[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]))) <= z[k]))
+            k--;
+        if (k < 0) {
+            k = 0;
+            v[0] = q;
+            z[0] = -INF;
+        }
+        else {
+            v[++k] = q;
+            z[k] = s;
+        }
+        z[k + 1] = INF;
+    }
+    for (int q = 0, j = 0; q < n; q++) {
+        while (z[j + 1] < q)
+            j++;
+        d[q] = g[v[j]] >= INF ? INF : (q - v[j]) * (q - v[j]) + g[v[j]];
+    }
+    for (int q = 0; q < n; q++)
+        f[q * stride] = d[q];
+}
+
+void edt2D(float* f) {
+    for (int y = 0; y < maskH; y++)
+        edt(f + y * maskW, maskW, 1);
+    for (int x = 0; x < maskW; x++)
+        edt(f + x, maskH, maskW);
+}
+
+// Signed distance in pixels from two transforms: to the shape, and to its complement.
+// A partially covered pixel is seeded with the distance from its center to an edge
+// through it, estimated as |coverage - 0.5| pixels.
+void buildField() {
+    static float inside[MAX_MASK * MAX_MASK];
+    for (int i = 0; i < maskW * maskH; i++) {
+        float c = coverage[i];
+        field[i] = c >= 0.5f ? 0.0f : c > 0.0f ? (0.5f - c) * (0.5f - c) : INF;
+        inside[i] = c <= 0.5f ? 0.0f : c < 1.0f ? (c - 0.5f) * (c - 0.5f) : INF;
+    }
+    edt2D(field);
+    edt2D(inside);
+    for (int i = 0; i < maskW * maskH; i++)
+        field[i] = sqrtf(field[i]) - sqrtf(inside[i]);
+}
+
+// Bilinear lookup of the field in scene units. Outside the mask the distance
+// to its square is a lower bound.
+float maskSDF(float x, float y) {
+    float scale = MASK_SIZE / maskW;
+    float u = (x - MASK_X0) / scale - 0.5f, v = (y - MASK_Y0) / scale - 0.5f; // Pixel centers
+    if (u < 0.0f || v < 0.0f || u >= maskW - 1 || v >= maskH - 1) {
+        float dx = fmaxf(fmaxf(-u, u - (maskW - 1)), 0.0f), dy = fmaxf(fmaxf(-v, v - (maskH - 1)), 0.0f);
+        return fmaxf(sqrtf(dx * dx + dy * dy), EPSILON * 2.0f) * scale;
+    }
+    int i = (int)u, j = (int)v;
+    float fu = u - i, fv = v - j;
+    const float* a = &field[j * maskW + i], * b = a + maskW;
+    return ((a[0] * (1.0f - fu) + a[1] * fu) * (1.0f - fv) + (b[0] * (1.0f - fu) + b[1] * fu) * fv) * scale;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, -0.2f, 0.1f), 10.0f, 0.0f, 0.0f };
+    Result b = { maskSDF(x, y), 0.0f, 0.2f, 1.5f };
+    // Result b = { maskSDF(x, y), 2.0f, 0.0f, 0.0f };
+    return unionOp(a, b);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float schlick(float cosi, float cost, float etai, float etat) {
+    float r0 = (etai - etat) / (etai + etat);
+    r0 *= r0;
+    float a = 1.0f - (etai < etat ? cosi : cost);
+    float aa = a * a;
+    return r0 + (1.0f - r0) * aa * aa * a;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        // refl = sign < 0.0f ? schlick(cosi, cost, r.eta, 1.0f) : schlick(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum / N;
+}
+
+// Usage: ./mask [mask.pgm], a procedural mask is used without a file
+int main(int argc, char* argv[]) {
+    if (argc > 1 && !loadPGM(argv[1])) {
+        fprintf(stderr, "cannot load %s as an 8-bit binary PGM up to %dx%d\n", argv[1], MAX_MASK, MAX_MASK);
+        return 1;
+    }
+    if (argc <= 1)
+        proceduralMask();
+    buildField();
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("mask.png", "wb"), W, H, img, 0);
+}
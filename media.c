@@ -0,0 +1,231 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), logf(), asinf(), atan2f()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define MAX_SCATTER 4           // Orders of scattering
+#define DENSITY_SIZE 65         // Density samples over the unit square, bilinearly interpolated
+#define DENSITY 10.0f           // Peak extinction coefficient
+#define ALBEDO 0.8f             // Scattering over extinction
+#define GRID 16                 // Majorant cells over the unit square
+#define LIGHT_X 0.15f
+#define LIGHT_Y 0.15f
+#define LIGHT_R 0.05f
+
+typedef struct { float sd, emissive; } Result;
+
+unsigned char img[W * H * 3];
+float density[DENSITY_SIZE][DENSITY_SIZE], majorant[GRID][GRID];
+int grid;
+long long rayCount, lookupCount;
+
+float uniform() {
+    return (float)rand() / ((float)RAND_MAX + 1.0f);
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+// Surfaces only, an emitter and black occluders casting shafts through the medium
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, LIGHT_X, LIGHT_Y, LIGHT_R), 10.0f };
+    Result b = {    boxSDF(x, y, 0.35f, 0.4f, TWO_PI / 16.0f, 0.06f, 0.02f), 0.0f };
+    Result c = { circleSDF(x, y, 0.45f, 0.2f, 0.04f), 0.0f };
+    return unionOp(a, unionOp(b, c));
+}
+
+// Patchy smoke, zero in the gaps so that the majorant grid can skip them
+void buildDensity() {
+    for (int j = 0; j < DENSITY_SIZE; j++)
+        for (int i = 0; i < DENSITY_SIZE; i++) {
+            float u = (float)i / (DENSITY_SIZE - 1), v = (float)j / (DENSITY_SIZE - 1);
+            float n = 0.5f + 0.25f * sinf(11.0f * u + 2.0f * sinf(7.0f * v)) + 0.25f * sinf(13.0f * v + 3.0f * sinf(5.0f * u));
+            density[j][i] = DENSITY * fminf(fmaxf((n - 0.45f) * 2.0f, 0.0f), 1.0f) * v;
+        }
+}
+
+float densityAt(float x, float y) {
+    lookupCount++;
+    if (x < 0.0f || y < 0.0f || x >= 1.0f || y >= 1.0f)
+        return 0.0f;
+    float u = x * (DENSITY_SIZE - 1), v = y * (DENSITY_SIZE - 1);
+    int i = (int)u, j = (int)v;
+    float fu = u - i, fv = v - j;
+    return (density[j][i] * (1.0f - fu) + density[j][i + 1] * fu) * (1.0f - fv) + (density[j + 1][i] * (1.0f - fu) + density[j + 1][i + 1] * fu) * fv;
+}
+
+// The bilinear density is a convex combination of its samples, so the
+// largest sample touching a cell bounds the density in it exactly.
+void buildMajorant(int n) {
+    grid = n;
+    for (int cy = 0; cy < n; cy++)
+        for (int cx = 0; cx < n; cx++) {
+            float m = 0.0f;
+            for (int j = cy * (DENSITY_SIZE - 1) / n; j <= ((cy + 1) * (DENSITY_SIZE - 1) + n - 1) / n; j++)
+                for (int i = cx * (DENSITY_SIZE - 1) / n; i <= ((cx + 1) * (DENSITY_SIZE - 1) + n - 1) / n; i++)
+                    m = fmaxf(m, density[j][i]);
+            majorant[cy][cx] = m;
+        }
+}
+
+// Walks the majorant cells along the ray up to tMax with a grid DDA
+// (Amanatides and Woo 1987), sampling tentative collisions with the majorant
+// of each cell. Without transmittance this is delta tracking (Woodcock et al.
+// 1965), which returns the distance of the first real collision or tMax.
+// Otherwise it is ratio tracking (Novak et al. 2014), which multiplies the
+// null collision probabilities into an unbiased transmittance estimate.
+// Empty cells cost nothing and dense cells cost about their optical depth.
+float track(float ox, float oy, float dx, float dy, float tMax, float* transmittance) {
+    float t0 = 0.0f, t1 = tMax;
+    if (transmittance)
+        *transmittance = 1.0f;
+    // Clip to the unit square
+    float o[2] = { ox, oy }, d[2] = { dx, dy };
+    for (int k = 0; k < 2; k++)
+        if (fabsf(d[k]) < EPSILON) {
+            if (o[k] < 0.0f || o[k] >= 1.0f)
+                return tMax;
+        }
+        else {
+            float a = -o[k] / d[k], b = (1.0f - o[k]) / d[k];
+            t0 = fmaxf(t0, fminf(a, b));
+            t1 = fminf(t1, fmaxf(a, b));
+        }
+    if (t0 >= t1)
+        return tMax;
+
+    float x = (ox + dx * t0) * grid, y = (oy + dy * t0) * grid;
+    int cx = (int)fminf(fmaxf(x, 0.0f), grid - 1.0f), cy = (int)fminf(fmaxf(y, 0.0f), grid - 1.0f);
+    int stepX = dx > 0.0f ? 1 : -1, stepY = dy > 0.0f ? 1 : -1;
+    float deltaX = fabsf(dx) < EPSILON ? MAX_DISTANCE : 1.0f / (grid * fabsf(dx));
+    float deltaY = fabsf(dy) < EPSILON ? MAX_DISTANCE : 1.0f / (grid * fabsf(dy));
+    float nextX = fabsf(dx) < EPSILON ? MAX_DISTANCE : t0 + ((dx > 0.0f ? cx + 1 - x : x - cx) / grid) / fabsf(dx);
+    float nextY = fabsf(dy) < EPSILON ? MAX_DISTANCE : t0 + ((dy > 0.0f ? cy + 1 - y : y - cy) / grid) / fabsf(dy);
+    for (float t = t0; t < t1 && cx >= 0 && cy >= 0 && cx < grid && cy < grid; ) {
+        float end = fminf(fminf(nextX, nextY), t1), m = majorant[cy][cx];
+        if (m > 0.0f)
+            for (float s = t - logf(1.0f - uniform()) / m; s < end; s -= logf(1.0f - uniform()) / m) {
+                float d = densityAt(ox + dx * s, oy + dy * s);
+                if (transmittance)
+                    *transmittance *= 1.0f - d / m;
+                else if (uniform() * m < d)
+                    return s;
+            }
+        t = end; // Exponential distances are memoryless, so sampling restarts at the boundary
+        if (nextX < nextY) {
+            cx += stepX;
+            nextX += deltaX;
+        }
+        else {
+            cy += stepY;
+            nextY += deltaY;
+        }
+    }
+    return tMax;
+}
+
+// First surface along the ray by sphere tracing
+int march(float ox, float oy, float dx, float dy, float* t, Result* r) {
+    *t = 1e-3f;
+    for (int i = 0; i < MAX_STEP && *t < MAX_DISTANCE; i++) {
+        *r = scene(ox + dx * *t, oy + dy * *t);
+        if (r->sd < EPSILON)
+            return 1;
+        *t += r->sd;
+    }
+    return 0;
+}
+
+// In-scattered light from the emitter, sampled uniformly in the angle it
+// subtends, times the isotropic phase function 1 / TWO_PI of flatland
+float directLight(float x, float y) {
+    float ux = LIGHT_X - x, uy = LIGHT_Y - y, d = sqrtf(ux * ux + uy * uy);
+    if (d <= LIGHT_R)
+        return 0.0f;
+    float half = asinf(LIGHT_R / d), a = atan2f(uy, ux) + (2.0f * uniform() - 1.0f) * half, t, transmittance;
+    Result r;
+    if (!march(x, y, cosf(a), sinf(a), &t, &r) || r.emissive <= 0.0f)
+        return 0.0f; // Occluded
+    track(x, y, cosf(a), sinf(a), t, &transmittance);
+    return r.emissive * transmittance * 2.0f * half / TWO_PI;
+}
+
+// A path through the medium. Emission is only counted before the first
+// scattering, afterwards the emitter is reached by next event estimation.
+float trace(float ox, float oy, float dx, float dy) {
+    float sum = 0.0f, weight = 1.0f;
+    rayCount++;
+    for (int i = 0; i < MAX_SCATTER; i++) {
+        float t, tMax;
+        Result r;
+        int hit = march(ox, oy, dx, dy, &t, &r);
+        tMax = hit ? t : MAX_DISTANCE;
+        float s = track(ox, oy, dx, dy, tMax, NULL);
+        if (s >= tMax) {
+            if (hit && i == 0)
+                sum += r.emissive;
+            break;
+        }
+        ox += dx * s;
+        oy += dy * s;
+        weight *= ALBEDO;
+        sum += weight * directLight(ox, oy);
+        float a = TWO_PI * uniform();
+        dx = cosf(a);
+        dy = sinf(a);
+    }
+    return sum;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + uniform()) / N;
+        sum += trace(x, y, cosf(a), sinf(a));
+    }
+    return sum / N;
+}
+
+// Density lookups per path of a subset of pixels with one global majorant and with the grid
+void statistics() {
+    for (int k = 0; k < 2; k++) {
+        buildMajorant(k ? GRID : 1);
+        rayCount = lookupCount = 0;
+        srand(0);
+        for (int y = 0; y < H; y += 16)
+            for (int x = 0; x < W; x += 16)
+                sample((float)x / W, (float)y / H);
+        printf("%2dx%-2d majorant grid  %6.2f density lookups/path\n", grid, grid, (double)lookupCount / rayCount);
+    }
+}
+
+int main() {
+    buildDensity();
+    statistics();
+    buildMajorant(GRID);
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("media.png", "wb"), W, H, img, 0);
+}
@@ -0,0 +1,296 @@
+#include <stdio.h> // FILE, fopen(), fputc(), fwrite()
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX, atoi(), malloc(), free()
+
+#define TWO_PI 6.28318530718f
+#define W 4096
+#define H 4096
+#define N 16
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define BAND 16                 // Rows rendered and written at a time
+#define MAX_BLOCK 65535         // Maximum size of a stored deflate block
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+
+// PNG output state: chunk CRC and the adler-32 of the zlib stream, which spans all IDAT chunks
+typedef struct { FILE* fp; unsigned crc, a, b, pending; } Writer;
+
+unsigned crcTable[256];
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    float u = x - 0.5f, v = y - 0.5f, t = fmodf(atan2f(v, u) + TWO_PI, TWO_PI / 16), s = sqrtf(u * u + v * v);
+    x = fabsf(x - 0.5f) + 0.5f;
+    Color m = { 0.0f, 3.0f, 3.0f };
+    Result a = { ngonSDF(x, y, 0.7f, 0.35f, 0.2f, 16), 0.0f, 1.77f, BLACK, m };
+    Result b = { ngonSDF(x, y, 0.35f, 0.35f, 0.55f, 32), 0.0f, 1.77f, BLACK, m };
+    Result c = {  planeSDF(x, y, 0.5f, 0.35f, 0.0f, -1.0f), 0.0f, 1.77f, BLACK, m };
+    Result d = { circleSDF(s * cosf(t), s * sinf(t), 0.6f * cosf(TWO_PI / 32), 0.5f * sinf(TWO_PI / 32), 0.05f), 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK };
+    return unionOp(unionOp(a, intersectOp(b, c)), d);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            Color sum = r.emissive;
+            if (depth < MAX_DEPTH && r.eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            Color c = colorMultiply(sum, beerLambert(r.absorption, t));
+            return c;
+        }
+        t += r.sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+Color sample(float x, float y, int n) {
+    Color sum = BLACK;
+    for (int i = 0; i < n; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / n;
+        sum = colorAdd(sum, trace(x, y, cosf(a), sinf(a), 0));
+    }
+    return colorScale(sum, 1.0f / n);
+}
+
+void crcInit() {
+    for (unsigned n = 0; n < 256; n++) {
+        unsigned c = n;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        crcTable[n] = c;
+    }
+}
+
+void put(Writer* wr, unsigned char u) {
+    fputc(u, wr->fp);
+    wr->crc = crcTable[(wr->crc ^ u) & 255] ^ (wr->crc >> 8);
+}
+
+void put32(Writer* wr, unsigned u) {
+    put(wr, u >> 24);
+    put(wr, (u >> 16) & 255);
+    put(wr, (u >> 8) & 255);
+    put(wr, u & 255);
+}
+
+// Stored data of the zlib stream. The modulo of adler-32 is deferred
+// for 5552 bytes, the most that cannot overflow 32 bits.
+void putData(Writer* wr, const unsigned char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        put(wr, data[i]);
+        wr->a += data[i];
+        wr->b += wr->a;
+        if (++wr->pending == 5552) {
+            wr->a %= 65521;
+            wr->b %= 65521;
+            wr->pending = 0;
+        }
+    }
+}
+
+void beginChunk(Writer* wr, const char* type, unsigned length) {
+    fputc(length >> 24, wr->fp);
+    fputc((length >> 16) & 255, wr->fp);
+    fputc((length >> 8) & 255, wr->fp);
+    fputc(length & 255, wr->fp);
+    wr->crc = ~0u;
+    for (int i = 0; i < 4; i++)
+        put(wr, type[i]);
+}
+
+void endChunk(Writer* wr) {
+    unsigned c = ~wr->crc;
+    fputc(c >> 24, wr->fp);
+    fputc((c >> 16) & 255, wr->fp);
+    fputc((c >> 8) & 255, wr->fp);
+    fputc(c & 255, wr->fp);
+}
+
+// Each row is split into stored blocks of at most MAX_BLOCK bytes, so any width
+// works. The zlib header and adler-32 trailer are chunks of their own, and each
+// band is one IDAT chunk whose length is known before its rows are rendered.
+void pngBegin(Writer* wr, unsigned w, unsigned h) {
+    static const unsigned char header[] = { 0x78, 1 };
+    fwrite("\x89PNG\r\n\32\n", 1, 8, wr->fp);
+    beginChunk(wr, "IHDR", 13);
+    put32(wr, w);
+    put32(wr, h);
+    put(wr, 8); // Depth
+    put(wr, 2); // True color
+    put(wr, 0); // Deflate
+    put(wr, 0); // No filter
+    put(wr, 0); // No interlace
+    endChunk(wr);
+    beginChunk(wr, "IDAT", 2);
+    put(wr, header[0]);
+    put(wr, header[1]);
+    endChunk(wr);
+    wr->a = 1;
+    wr->b = wr->pending = 0;
+}
+
+void pngBand(Writer* wr, unsigned w, unsigned rows, int last, const unsigned char* band) {
+    static const unsigned char filter = 0;
+    size_t pitch = (size_t)w * 3 + 1, blocks = (pitch + MAX_BLOCK - 1) / MAX_BLOCK;
+    beginChunk(wr, "IDAT", (unsigned)(rows * (pitch + blocks * 5)));
+    for (unsigned y = 0; y < rows; y++, band += pitch - 1)
+        for (size_t k = 0; k < blocks; k++) {
+            size_t begin = k * MAX_BLOCK, end = begin + MAX_BLOCK < pitch ? begin + MAX_BLOCK : pitch;
+            unsigned size = (unsigned)(end - begin);
+            put(wr, last && y == rows - 1 && k == blocks - 1); // Final block
+            put(wr, size & 255);
+            put(wr, size >> 8);
+            put(wr, ~size & 255);
+            put(wr, (~size >> 8) & 255);
+            if (begin == 0) { // Filter byte leads each row
+                putData(wr, &filter, 1);
+                begin = 1;
+            }
+            putData(wr, band + begin - 1, end - begin);
+        }
+    endChunk(wr);
+}
+
+void pngEnd(Writer* wr) {
+    beginChunk(wr, "IDAT", 4);
+    put32(wr, ((wr->b % 65521) << 16) | (wr->a % 65521));
+    endChunk(wr);
+    beginChunk(wr, "IEND", 0);
+    endChunk(wr);
+}
+
+// Usage: ./outofcore [width height samples], e.g. ./outofcore 65536 65536 4
+// Peak memory is one band of pixels regardless of the image size.
+int main(int argc, char* argv[]) {
+    unsigned w = argc > 3 ? atoi(argv[1]) : W, h = argc > 3 ? atoi(argv[2]) : H;
+    int n = argc > 3 ? atoi(argv[3]) : N;
+    if (w == 0 || h == 0 || n <= 0) {
+        fprintf(stderr, "usage: %s [width height samples]\n", argv[0]);
+        return 1;
+    }
+    unsigned char* band = malloc((size_t)w * 3 * BAND);
+    Writer wr = { NULL, 0, 0, 0, 0 };
+    if (!band || !(wr.fp = fopen("outofcore.png", "wb"))) {
+        fprintf(stderr, "cannot allocate a band or create outofcore.png\n");
+        free(band);
+        return 1;
+    }
+    crcInit();
+    pngBegin(&wr, w, h);
+    for (unsigned y0 = 0; y0 < h; y0 += BAND) {
+        unsigned rows = h - y0 < BAND ? h - y0 : BAND;
+        unsigned char* p = band;
+        for (unsigned y = y0; y < y0 + rows; y++)
+            for (unsigned x = 0; x < w; x++, p += 3) {
+                Color c = sample((float)x / w, (float)y / h, n);
+                p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+                p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+                p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+            }
+        pngBand(&wr, w, rows, y0 + rows == h, band);
+    }
+    pngEnd(&wr);
+    fclose(wr.fp);
+    free(band);
+}
@@ -0,0 +1,342 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), ceilf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX, qsort()
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define MAX_EDGE 512
+#define MAX_SHAPE 4
+#define LEAF 4                  // Maximum edges in a BVH leaf
+#define TOLERANCE 1e-4f         // Maximum deviation of flattened curves
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+typedef struct { float ax, ay, bx, by; } Edge;
+
+// Leaf of edges [first, first + count), or inner node with children first and first + 1
+typedef struct { float x0, y0, x1, y1; int first, count; } Node;
+
+// Closed paths flattened into edges, filled by the nonzero winding rule
+typedef struct {
+    int edgeCount, nodeCount;
+    float x, y, sx, sy; // Current point and start of the subpath
+    float emissive, reflectivity, eta;
+    Edge edges[MAX_EDGE];
+    Node nodes[2 * MAX_EDGE];
+} Shape;
+
+unsigned char img[W * H * 3];
+Shape shapes[MAX_SHAPE];
+int shapeCount, sortAxis;
+
+void moveTo(Shape* s, float x, float y) {
+    s->x = s->sx = x;
+    s->y = s->sy = y;
+}
+
+void lineTo(Shape* s, float x, float y) {
+    Edge e = { s->x, s->y, x, y };
+    s->edges[s->edgeCount++] = e;
+    s->x = x;
+    s->y = y;
+}
+
+// Curves are flattened into uniform steps, with the count bounded by the second
+// derivative so that the chords deviate less than TOLERANCE
+void quadTo(Shape* s, float bx, float by, float cx, float cy) {
+    float ax = s->x, ay = s->y, dx = ax - 2.0f * bx + cx, dy = ay - 2.0f * by + cy;
+    int n = (int)ceilf(sqrtf(sqrtf(dx * dx + dy * dy) / (4.0f * TOLERANCE)));
+    for (int i = 1; i <= n; i++) {
+        float t = (float)i / n, u = 1.0f - t;
+        lineTo(s, u * u * ax + 2.0f * u * t * bx + t * t * cx, u * u * ay + 2.0f * u * t * by + t * t * cy);
+    }
+}
+
+void cubicTo(Shape* s, float bx, float by, float cx, float cy, float dx, float dy) {
+    float ax = s->x, ay = s->y;
+    float ex = fmaxf(fabsf(ax - 2.0f * bx + cx), fabsf(bx - 2.0f * cx + dx));
+    float ey = fmaxf(fabsf(ay - 2.0f * by + cy), fabsf(by - 2.0f * cy + dy));
+    int n = (int)ceilf(sqrtf(6.0f * sqrtf(ex * ex + ey * ey) / (8.0f * TOLERANCE)));
+    for (int i = 1; i <= n; i++) {
+        float t = (float)i / n, u = 1.0f - t;
+        lineTo(s, u * u * u * ax + 3.0f * u * u * t * bx + 3.0f * u * t * t * cx + t * t * t * dx,
+                  u * u * u * ay + 3.0f * u * u * t * by + 3.0f * u * t * t * cy + t * t * t * dy);
+    }
+}
+
+void closePath(Shape* s) {
+    if (s->x != s->sx || s->y != s->sy)
+        lineTo(s, s->sx, s->sy);
+}
+
+int compareEdge(const void* a, const void* b) {
+    const Edge* p = a, * q = b;
+    float u = sortAxis ? p->ay + p->by : p->ax + p->bx, v = sortAxis ? q->ay + q->by : q->ax + q->bx;
+    return (u > v) - (u < v);
+}
+
+// Median split of the edges along the longer axis of their bounds
+void build(Shape* s, int index, int first, int count) {
+    Node* node = &s->nodes[index];
+    node->x0 = node->y0 = MAX_DISTANCE;
+    node->x1 = node->y1 = -MAX_DISTANCE;
+    for (int i = first; i < first + count; i++) {
+        const Edge* e = &s->edges[i];
+        node->x0 = fminf(node->x0, fminf(e->ax, e->bx));
+        node->y0 = fminf(node->y0, fminf(e->ay, e->by));
+        node->x1 = fmaxf(node->x1, fmaxf(e->ax, e->bx));
+        node->y1 = fmaxf(node->y1, fmaxf(e->ay, e->by));
+    }
+    node->first = first;
+    node->count = count;
+    if (count <= LEAF)
+        return;
+    sortAxis = node->y1 - node->y0 > node->x1 - node->x0;
+    qsort(s->edges + first, count, sizeof(Edge), compareEdge);
+    node->first = s->nodeCount;
+    node->count = 0;
+    s->nodeCount += 2;
+    build(s, node->first, first, count / 2);
+    build(s, node->first + 1, first + count / 2, count - count / 2);
+}
+
+void finish(Shape* s, float emissive, float reflectivity, float eta) {
+    s->emissive = emissive;
+    s->reflectivity = reflectivity;
+    s->eta = eta;
+    s->nodeCount = 1;
+    build(s, 0, 0, s->edgeCount);
+    shapeCount++;
+}
+
+float edgeDistance2(const Edge* e, float x, float y) {
+    float vx = x - e->ax, vy = y - e->ay, ux = e->bx - e->ax, uy = e->by - e->ay;
+    float t = fmaxf(fminf((vx * ux + vy * uy) / (ux * ux + uy * uy), 1.0f), 0.0f);
+    float dx = vx - ux * t, dy = vy - uy * t;
+    return dx * dx + dy * dy;
+}
+
+float boxDistance2(const Node* n, float x, float y) {
+    float dx = fmaxf(fmaxf(n->x0 - x, x - n->x1), 0.0f), dy = fmaxf(fmaxf(n->y0 - y, y - n->y1), 0.0f);
+    return dx * dx + dy * dy;
+}
+
+// Winding number contribution of the upward and downward crossings right of (x, y)
+int edgeWinding(const Edge* e, float x, float y) {
+    float cross = (e->bx - e->ax) * (y - e->ay) - (x - e->ax) * (e->by - e->ay);
+    if (e->ay <= y)
+        return e->by > y && cross > 0.0f ? 1 : 0;
+    return e->by <= y && cross < 0.0f ? -1 : 0;
+}
+
+// Signed distance by branch and bound over the BVH, nearer child first, skipping
+// nodes farther than the best edge so far. The winding number only visits
+// nodes whose bounds straddle y and extend right of x.
+float shapeSDF(const Shape* s, float x, float y) {
+    int stack[64], top = 0, winding = 0;
+    float best = MAX_DISTANCE * MAX_DISTANCE;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node* n = &s->nodes[stack[--top]];
+        if (boxDistance2(n, x, y) >= best)
+            continue;
+        if (n->count > 0)
+            for (int i = n->first; i < n->first + n->count; i++)
+                best = fminf(best, edgeDistance2(&s->edges[i], x, y));
+        else {
+            int near = boxDistance2(&s->nodes[n->first], x, y) > boxDistance2(&s->nodes[n->first + 1], x, y);
+            stack[top++] = n->first + 1 - near;
+            stack[top++] = n->first + near;
+        }
+    }
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node* n = &s->nodes[stack[--top]];
+        if (y < n->y0 || y > n->y1 || x > n->x1)
+            continue;
+        if (n->count > 0)
+            for (int i = n->first; i < n->first + n->count; i++)
+                winding += edgeWinding(&s->edges[i], x, y);
+        else {
+            stack[top++] = n->first;
+            stack[top++] = n->first + 1;
+        }
+    }
+    return winding ? -sqrtf(best) : sqrtf(best);
+}
+
+// The same distance from all edges, for comparison
+float bruteForceSDF(const Shape* s, float x, float y) {
+    float best = MAX_DISTANCE * MAX_DISTANCE;
+    int winding = 0;
+    for (int i = 0; i < s->edgeCount; i++) {
+        best = fminf(best, edgeDistance2(&s->edges[i], x, y));
+        winding += edgeWinding(&s->edges[i], x, y);
+    }
+    return winding ? -sqrtf(best) : sqrtf(best);
+}
+
+// A biconvex lens with aspheric cubic sides and a glass gear with rounded teeth
+void load() {
+    Shape* s = &shapes[shapeCount];
+    moveTo(s, 0.35f, 0.25f);
+    cubicTo(s, 0.48f, 0.35f, 0.48f, 0.65f, 0.35f, 0.75f);
+    cubicTo(s, 0.22f, 0.65f, 0.22f, 0.35f, 0.35f, 0.25f);
+    closePath(s);
+    finish(s, 0.0f, 0.2f, 1.5f);
+
+    s = &shapes[shapeCount];
+    const int teeth = 16;
+    const float cx = 0.72f, cy = 0.6f, r0 = 0.13f, r1 = 0.17f, a = TWO_PI / teeth;
+    moveTo(s, cx + r0, cy);
+    for (int i = 0; i < teeth; i++) {
+        float t = a * i;
+        lineTo(s, cx + r0 * cosf(t + a * 0.15f), cy + r0 * sinf(t + a * 0.15f));
+        lineTo(s, cx + r1 * cosf(t + a * 0.3f), cy + r1 * sinf(t + a * 0.3f));
+        quadTo(s, cx + r1 * 1.08f * cosf(t + a * 0.45f), cy + r1 * 1.08f * sinf(t + a * 0.45f), cx + r1 * cosf(t + a * 0.6f), cy + r1 * sinf(t + a * 0.6f));
+        lineTo(s, cx + r0 * cosf(t + a * 0.75f), cy + r0 * sinf(t + a * 0.75f));
+        lineTo(s, cx + r0 * cosf(t + a), cy + r0 * sinf(t + a));
+    }
+    closePath(s);
+    moveTo(s, cx + 0.05f, cy); // Hole wound the other way
+    for (int i = 1; i <= 32; i++)
+        lineTo(s, cx + 0.05f * cosf(-TWO_PI * i / 32), cy + 0.05f * sinf(-TWO_PI * i / 32));
+    closePath(s);
+    finish(s, 0.0f, 0.2f, 1.5f);
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result r = { circleSDF(x, y, 0.05f, 0.5f, 0.05f), 10.0f, 0.0f, 0.0f };
+    for (int i = 0; i < shapeCount; i++) {
+        Result s = { shapeSDF(&shapes[i], x, y), shapes[i].emissive, shapes[i].reflectivity, shapes[i].eta };
+        r = unionOp(r, s);
+    }
+    return r;
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float schlick(float cosi, float cost, float etai, float etat) {
+    float r0 = (etai - etat) / (etai + etat);
+    r0 *= r0;
+    float a = 1.0f - (etai < etat ? cosi : cost);
+    float aa = a * a;
+    return r0 + (1.0f - r0) * aa * aa * a;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        // refl = sign < 0.0f ? schlick(cosi, cost, r.eta, 1.0f) : schlick(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return 0.0f;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum / N;
+}
+
+// Time BVH and brute force distance queries of each shape over the image
+void compare() {
+    for (int i = 0; i < shapeCount; i++) {
+        double seconds[2];
+        float maxError = 0.0f;
+        for (int k = 0; k < 2; k++) {
+            clock_t start = clock();
+            for (int y = 0; y < H; y++)
+                for (int x = 0; x < W; x++) {
+                    float d = k ? bruteForceSDF(&shapes[i], (float)x / W, (float)y / H) : shapeSDF(&shapes[i], (float)x / W, (float)y / H);
+                    maxError = fmaxf(maxError, k ? fabsf(d - shapeSDF(&shapes[i], (float)x / W, (float)y / H)) : 0.0f);
+                }
+            seconds[k] = (double)(clock() - start) / CLOCKS_PER_SEC;
+        }
+        printf("shape %d: %d edges, %d nodes, bvh %.3fs, brute force %.3fs, max difference %g\n",
+            i, shapes[i].edgeCount, shapes[i].nodeCount, seconds[0], seconds[1], maxError);
+    }
+}
+
+int main() {
+    load();
+    compare();
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3)
+            p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+    svpng(fopen("polygon.png", "wb"), W, H, img, 0);
+}
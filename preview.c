@@ -0,0 +1,134 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX, atof()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define LEVELS 4                // Preview pyramid from W >> (LEVELS - 1) up to W
+
+typedef struct { float sd, emissive, reflectivity; } Result;
+
+// Rectangle of the scene mapped onto the image, [0, 1] x [0, 1] for the whole scene
+typedef struct { float x0, y0, x1, y1; } View;
+
+unsigned char img[2][W * H * 3];
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result subtractOp(Result a, Result b) {
+    Result r = a;
+    r.sd = (a.sd > -b.sd) ? a.sd : -b.sd;
+    return r;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.4f, 0.2f, 0.1f), 2.0f, 0.0f };
+    Result d = {  planeSDF(x, y, 0.0f, 0.5f, 0.0f, -1.0f), 0.0f, 0.9f };
+    Result e = { circleSDF(x, y, 0.5f, 0.5f, 0.4f), 0.0f, 0.9f };
+    return unionOp(a, subtractOp(d, e));
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 0.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd < EPSILON) {
+            float sum = r.emissive;
+            if (depth < MAX_DEPTH && r.reflectivity > 0.0f) {
+                float nx, ny, rx, ry;
+                gradient(x, y, &nx, &ny);
+                reflect(dx, dy, nx, ny, &rx, &ry);
+                sum += r.reflectivity * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+            }
+            return sum;
+        }
+        t += r.sd;
+    }
+    return 0.0f;
+}
+
+float sample(float x, float y, int n) {
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / n;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum / n;
+}
+
+void shade(View v, int w, int h, int n, int x, int y, unsigned char* buffer) {
+    unsigned char* p = buffer + (y * w + x) * 3;
+    p[0] = p[1] = p[2] = (int)(fminf(sample(v.x0 + (v.x1 - v.x0) * x / w, v.y0 + (v.y1 - v.y0) * y / h, n) * 255.0f, 255.0f));
+}
+
+// Render the view into a w by h buffer with n samples per pixel
+void render(View v, int w, int h, int n, unsigned char* buffer) {
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            shade(v, w, h, n, x, y, buffer);
+}
+
+// Render the view at twice the size of a coarse render. Pixel (2x, 2y) lies at
+// the same point as coarse pixel (x, y) and is copied, so only three quarters
+// of the pixels are sampled and the pyramid costs no more than the last level.
+void refine(View v, int w, int h, int n, const unsigned char* coarse, unsigned char* buffer) {
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            if ((x | y) & 1)
+                shade(v, w, h, n, x, y, buffer);
+            else
+                for (int k = 0; k < 3; k++)
+                    buffer[(y * w + x) * 3 + k] = coarse[((y / 2) * (w / 2) + x / 2) * 3 + k];
+}
+
+// Usage: ./preview [x0 y0 x1 y1], e.g. ./preview 0.4 0.5 0.7 0.8 for the caustic
+// of the concave mirror. Writes preview0.png (coarsest) to preview3.png.
+int main(int argc, char* argv[]) {
+    View v = { 0.0f, 0.0f, 1.0f, 1.0f };
+    if (argc > 4) {
+        v.x0 = atof(argv[1]);
+        v.y0 = atof(argv[2]);
+        v.x1 = atof(argv[3]);
+        v.y1 = atof(argv[4]);
+    }
+    for (int k = 0; k < LEVELS; k++) {
+        int w = W >> (LEVELS - 1 - k), h = H >> (LEVELS - 1 - k);
+        char filename[32];
+        if (k == 0)
+            render(v, w, h, N, img[0]);
+        else
+            refine(v, w, h, N, img[(k - 1) & 1], img[k & 1]);
+        sprintf(filename, "preview%d.png", k);
+        svpng(fopen(filename, "wb"), w, h, img[k & 1], 0);
+    }
+}
@@ -0,0 +1,271 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <stdio.h> // fopen(), fprintf()
+#include <time.h> // clock_gettime()
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define TILE 32
+
+// Instrumentation level: 0 compiles it out, 1 times tiles, 2 also times
+// phases at about 20% overhead, e.g. gcc -Wall -O3 -DPROFILE=2 -o profile profile.c -lm
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+enum { PHASE_OTHER, PHASE_MARCH, PHASE_GRADIENT, PHASE_SHADE, PHASE_WRITE, PHASE_COUNT };
+
+typedef struct { float sd, emissive, reflectivity, eta; } Result;
+
+typedef struct { long long start, end, phase[PHASE_COUNT]; } TileRecord;
+
+unsigned char img[W * H * 3];
+
+#if PROFILE
+const char* phaseNames[PHASE_COUNT] = { "other", "march", "gradient", "shade", "write" };
+TileRecord tiles[(H + TILE - 1) / TILE][(W + TILE - 1) / TILE];
+long long phaseTime[PHASE_COUNT], last;
+int currentPhase;
+
+long long now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Charges the time since the last switch to the current phase and switches
+// to the given one, returning the previous phase. Time is exclusive, so the
+// march of a recursive ray is not counted in the shading that spawned it.
+int profileEnter(int phase) {
+    long long t = now();
+    int previous = currentPhase;
+    phaseTime[currentPhase] += t - last;
+    last = t;
+    currentPhase = phase;
+    return previous;
+}
+
+#endif
+
+#if PROFILE >= 2
+#define PROFILE_ENTER(phase) profileEnter(phase)
+#define PROFILE_SWITCH(phase) (void)profileEnter(phase)
+#define PROFILE_LEAVE(previous) (void)profileEnter(previous)
+#else
+#define PROFILE_ENTER(phase) 0
+#define PROFILE_SWITCH(phase) (void)0
+#define PROFILE_LEAVE(previous) (void)(previous)
+#endif
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result subtractOp(Result a, Result b) {
+    Result r = a;
+    r.sd = (a.sd > -b.sd) ? a.sd : -b.sd;
+    return r;
+}
+
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, -0.2f, -0.2f, 0.1f), 10.0f, 0.0f, 0.0f };
+    Result b = {    boxSDF(x, y, 0.5f, 0.5f, 0.0f, 0.3, 0.2f), 0.0f, 0.2f, 1.5f };
+    return unionOp(a, b);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+float trace(float ox, float oy, float dx, float dy, int depth) {
+    int previous = PROFILE_ENTER(PHASE_MARCH);
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            float sum = r.emissive;
+            PROFILE_SWITCH(PHASE_SHADE);
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                PROFILE_SWITCH(PHASE_GRADIENT);
+                gradient(x, y, &nx, &ny);
+                PROFILE_SWITCH(PHASE_SHADE);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        sum += (1.0f - refl) * trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1);
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum += refl * trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1);
+                }
+            }
+            PROFILE_LEAVE(previous);
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    PROFILE_LEAVE(previous);
+    return 0.0f;
+}
+
+float sample(float x, float y) {
+    float sum = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum += trace(x, y, cosf(a), sinf(a), 0);
+    }
+    return sum / N;
+}
+
+#if PROFILE
+// Chrome trace event format, open in chrome://tracing or Perfetto. Tiles are
+// complete events on the only thread, with their phase times as arguments.
+void writeTimeline(const char* filename, long long origin, long long writeStart, long long writeEnd) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp)
+        return;
+    fprintf(fp, "{\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"render\"}},\n");
+    for (int ty = 0; ty < (H + TILE - 1) / TILE; ty++)
+        for (int tx = 0; tx < (W + TILE - 1) / TILE; tx++) {
+            const TileRecord* r = &tiles[ty][tx];
+            fprintf(fp, "{\"name\":\"tile %d,%d\",\"cat\":\"tile\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+                tx, ty, (r->start - origin) * 1e-3, (r->end - r->start) * 1e-3);
+            for (int p = 0; PROFILE >= 2 && p < PHASE_COUNT; p++)
+                fprintf(fp, "%s\"%s_ms\":%.3f", p ? "," : "", phaseNames[p], r->phase[p] * 1e-6);
+            fprintf(fp, "}},\n");
+        }
+    fprintf(fp, "{\"name\":\"svpng\",\"cat\":\"write\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}\n]}\n",
+        (writeStart - origin) * 1e-3, (writeEnd - writeStart) * 1e-3);
+    fclose(fp);
+}
+
+// Tile times relative to the slowest, black through red and yellow to white
+void writeHeatmap(const char* filename) {
+    static unsigned char heat[W * H * 3];
+    long long slowest = 1;
+    for (int ty = 0; ty < (H + TILE - 1) / TILE; ty++)
+        for (int tx = 0; tx < (W + TILE - 1) / TILE; tx++)
+            if (tiles[ty][tx].end - tiles[ty][tx].start > slowest)
+                slowest = tiles[ty][tx].end - tiles[ty][tx].start;
+    unsigned char* p = heat;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            const TileRecord* r = &tiles[y / TILE][x / TILE];
+            float c = 3.0f * (r->end - r->start) / slowest;
+            p[0] = (int)(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f);
+            p[1] = (int)(fminf(fmaxf(c - 1.0f, 0.0f), 1.0f) * 255.0f);
+            p[2] = (int)(fminf(fmaxf(c - 2.0f, 0.0f), 1.0f) * 255.0f);
+        }
+    svpng(fopen(filename, "wb"), W, H, heat, 0);
+}
+#endif
+
+// Renders by tiles, recording the time and phases of each when profiling
+int main() {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#if PROFILE
+    long long origin = last = now();
+#endif
+    for (int ty = 0; ty < (H + TILE - 1) / TILE; ty++)
+        for (int tx = 0; tx < (W + TILE - 1) / TILE; tx++) {
+#if PROFILE
+            TileRecord* r = &tiles[ty][tx];
+            profileEnter(PHASE_OTHER);
+            for (int p = 0; p < PHASE_COUNT; p++)
+                r->phase[p] = -phaseTime[p];
+            r->start = last;
+#endif
+            for (int y = ty * TILE; y < (ty + 1) * TILE && y < H; y++)
+                for (int x = tx * TILE; x < (tx + 1) * TILE && x < W; x++) {
+                    unsigned char* p = img + (y * W + x) * 3;
+                    p[0] = p[1] = p[2] = (int)(fminf(sample((float)x / W, (float)y / H) * 255.0f, 255.0f));
+                }
+#if PROFILE
+            profileEnter(PHASE_OTHER);
+            for (int p = 0; p < PHASE_COUNT; p++)
+                r->phase[p] += phaseTime[p];
+            r->end = last;
+#endif
+        }
+#if PROFILE
+    long long writeStart = (profileEnter(PHASE_WRITE), last);
+#endif
+    svpng(fopen("profile.png", "wb"), W, H, img, 0);
+#if PROFILE
+    profileEnter(PHASE_OTHER);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("total %.3fs\n", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+#if PROFILE
+    for (int p = 0; PROFILE >= 2 && p < PHASE_COUNT; p++)
+        printf("%-8s %8.3fs %5.1f%%\n", phaseNames[p], phaseTime[p] * 1e-9, 100.0 * phaseTime[p] / (last - origin));
+    writeTimeline("profile.json", origin, writeStart, last);
+    writeHeatmap("profile_heatmap.png");
+#endif
+}
@@ -0,0 +1,98 @@
+#include "svpng.inc"
+#include <math.h> // fminf(), fmaxf(), floorf(), sinf(), cosf(), sqrt()
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define CASCADE_COUNT 6
+#define INTERVAL (2.0f / W)     // Length of cascade 0 rays, each cascade is 4 times longer
+#define MAX_STEP 64
+#define EPSILON 1e-6f
+
+typedef struct { float sd, emissive; } Result;
+
+unsigned char img[W * H * 3];
+
+// Every cascade has W * H * 4 entries: 2^i times fewer probes per axis, 4^i times more directions
+float buffers[2][W * H * 4];
+float *merged = buffers[0], *current = buffers[1];
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    Result r1 = { circleSDF(x, y, 0.3f, 0.3f, 0.10f), 2.0f };
+    Result r2 = { circleSDF(x, y, 0.3f, 0.7f, 0.05f), 0.8f };
+    Result r3 = { circleSDF(x, y, 0.7f, 0.5f, 0.10f), 0.0f };
+    return unionOp(unionOp(r1, r2), r3);
+}
+
+// March only within [tmin, tmax), transmittance is 0 if anything is hit
+float trace(float ox, float oy, float dx, float dy, float tmin, float tmax, float* transmittance) {
+    float t = tmin;
+    for (int i = 0; i < MAX_STEP && t < tmax; i++) {
+        Result r = scene(ox + dx * t, oy + dy * t);
+        if (r.sd < EPSILON) {
+            *transmittance = 0.0f;
+            return r.emissive;
+        }
+        t += r.sd;
+    }
+    *transmittance = 1.0f;
+    return 0.0f;
+}
+
+// Average of the 4 child directions of direction k at probe (px, py) of the merged upper cascade
+float upper(int level, int px, int py, int k) {
+    int pw = W >> level, ph = H >> level, dirs = 4 << (2 * level);
+    px = px < 0 ? 0 : px >= pw ? pw - 1 : px;
+    py = py < 0 ? 0 : py >= ph ? ph - 1 : py;
+    const float* m = merged + (py * pw + px) * dirs + k * 4;
+    return (m[0] + m[1] + m[2] + m[3]) * 0.25f;
+}
+
+void cascade(int level) {
+    int scale = 1 << level, pw = W >> level, ph = H >> level, dirs = 4 << (2 * level);
+    float tmin = INTERVAL * (scale * scale - 1) / 3.0f, tmax = tmin + INTERVAL * scale * scale;
+    for (int py = 0; py < ph; py++)
+        for (int px = 0; px < pw; px++) {
+            // Probe position in pixels, cascade 0 probes lie on pixels
+            float x = (px + 0.5f) * scale - 0.5f, y = (py + 0.5f) * scale - 0.5f;
+            float gx = (x + 0.5f) / (scale * 2) - 0.5f, gy = (y + 0.5f) / (scale * 2) - 0.5f;
+            int ux = (int)floorf(gx), uy = (int)floorf(gy);
+            float fx = gx - ux, fy = gy - uy;
+            for (int k = 0; k < dirs; k++) {
+                float a = TWO_PI * (k + 0.5f) / dirs, transmittance;
+                float L = trace(x / W, y / H, cosf(a), sinf(a), tmin, tmax, &transmittance);
+                if (level < CASCADE_COUNT - 1 && transmittance > 0.0f)
+                    L += transmittance * (
+                        (upper(level + 1, ux, uy, k) * (1.0f - fx) + upper(level + 1, ux + 1, uy, k) * fx) * (1.0f - fy) +
+                        (upper(level + 1, ux, uy + 1, k) * (1.0f - fx) + upper(level + 1, ux + 1, uy + 1, k) * fx) * fy);
+                current[(py * pw + px) * dirs + k] = L;
+            }
+        }
+    float* swap = merged;
+    merged = current;
+    current = swap;
+}
+
+int main() {
+    clock_t start = clock();
+    for (int level = CASCADE_COUNT - 1; level >= 0; level--)
+        cascade(level);
+    printf("%d cascades, %d rays, %.2fs\n", CASCADE_COUNT, CASCADE_COUNT * W * H * 4, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    unsigned char* p = img;
+    const float* m = merged;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3, m += 4)
+            p[0] = p[1] = p[2] = (int)(fminf((m[0] + m[1] + m[2] + m[3]) * 0.25f * 255.0f, 255.0f));
+    svpng(fopen("radiancecascades.png", "wb"), W, H, img, 0);
+}
@@ -0,0 +1,170 @@
+#include <stdio.h> // fopen(), fread(), fprintf(), fscanf()
+#include <math.h> // sqrt(), log10()
+#include <stdlib.h> // malloc(), realloc(), free(), system()
+#include <string.h> // memcmp(), strcmp()
+#include <time.h> // clock_gettime()
+
+#define REFERENCE_DIR "../reference/"
+#define TIME_TOLERANCE 1.5          // Fails if a run is slower than this factor of its reference time
+#define TIME_SLACK 0.25             // Seconds added to the limit, absorbs timer noise of short runs
+#define BLOCK 4                     // PSNR of block averages, which keeps bias but cuts Monte Carlo noise
+
+typedef struct { unsigned w, h; unsigned char* rgb; } Image;
+
+unsigned readU32(const unsigned char* p) {
+    return ((unsigned)p[0] << 24) | ((unsigned)p[1] << 16) | ((unsigned)p[2] << 8) | p[3];
+}
+
+// Reads 8-bit RGB PNGs with stored deflate blocks and no filters, as written by svpng()
+int readPNG(const char* filename, Image* image) {
+    FILE* fp = fopen(filename, "rb");
+    unsigned char* data = NULL, * zlib = NULL;
+    size_t size = 0, zsize = 0;
+    int ok = 0;
+    image->w = image->h = 0;
+    image->rgb = NULL;
+    if (!fp)
+        return 0;
+    for (unsigned char buffer[4096]; ; ) {
+        size_t n = fread(buffer, 1, sizeof(buffer), fp);
+        if (n == 0)
+            break;
+        data = realloc(data, size + n);
+        memcpy(data + size, buffer, n);
+        size += n;
+    }
+    fclose(fp);
+    if (size < 8 || memcmp(data, "\x89PNG\r\n\32\n", 8) != 0)
+        goto done;
+
+    // Concatenate the IDAT chunks
+    for (size_t p = 8; p + 12 <= size; ) {
+        unsigned length = readU32(data + p);
+        if (p + 12 + length > size)
+            goto done;
+        if (memcmp(data + p + 4, "IHDR", 4) == 0) {
+            image->w = readU32(data + p + 8);
+            image->h = readU32(data + p + 12);
+            if (data[p + 16] != 8 || data[p + 17] != 2 || data[p + 20] != 0)
+                goto done; // Not 8-bit RGB without interlace
+        }
+        else if (memcmp(data + p + 4, "IDAT", 4) == 0) {
+            zlib = realloc(zlib, zsize + length);
+            memcpy(zlib + zsize, data + p + 8, length);
+            zsize += length;
+        }
+        p += 12 + length;
+    }
+
+    // Inflate stored blocks, dropping the filter byte of each row
+    size_t pitch = (size_t)image->w * 3 + 1, total = pitch * image->h, out = 0;
+    unsigned char* raw = malloc(total);
+    for (size_t p = 2, last = 0; !last && p + 5 <= zsize; ) {
+        unsigned n = zlib[p + 1] | (zlib[p + 2] << 8);
+        last = zlib[p] & 1;
+        if ((zlib[p] & 6) != 0 || p + 5 + n > zsize || out + n > total)
+            break; // Only stored blocks are supported
+        memcpy(raw + out, zlib + p + 5, n);
+        out += n;
+        p += 5 + n;
+    }
+    if (out == total) {
+        image->rgb = malloc(total - image->h);
+        for (unsigned y = 0; y < image->h; y++)
+            memcpy(image->rgb + y * (pitch - 1), raw + y * pitch + 1, pitch - 1);
+        ok = 1;
+    }
+    free(raw);
+done:
+    free(data);
+    free(zlib);
+    return ok;
+}
+
+// Value of a check in a file of REFERENCE_DIR with lines of name and value, or -1 if not listed
+double lookup(const char* file, const char* name) {
+    char path[256], key[64];
+    double v, result = -1.0;
+    snprintf(path, sizeof(path), REFERENCE_DIR "%s", file);
+    FILE* fp = fopen(path, "r");
+    while (fp && fscanf(fp, "%63s %lf", key, &v) == 2)
+        if (strcmp(key, name) == 0)
+            result = v;
+    if (fp)
+        fclose(fp);
+    return result;
+}
+
+// Appends the run time of a check to REFERENCE_DIR "timings", see make timings
+int record(const char* name, double seconds) {
+    FILE* fp = fopen(REFERENCE_DIR "timings", "a");
+    if (!fp)
+        return 0;
+    fprintf(fp, "%s %.2f\n", name, seconds);
+    fclose(fp);
+    return 1;
+}
+
+// Usage: ./regress [-r] name, in the directory of the reduced check builds.
+// Runs ./name and compares name.png with the reference image of the same name.
+// Fails if the PSNR is below the threshold for Monte Carlo noise in
+// REFERENCE_DIR "thresholds", or if the run is slower than TIME_TOLERANCE
+// times its reference time in REFERENCE_DIR "timings" plus TIME_SLACK.
+// With -r the run time is appended to the timings instead of compared.
+// Thresholds are about 2dB below the PSNR of the checks when the references were made.
+int main(int argc, char* argv[]) {
+    char command[256], output[256], reference[256];
+    struct timespec start, end;
+    Image a, b;
+    int rebaseline = argc == 3 && strcmp(argv[1], "-r") == 0;
+    if (argc != 2 && !rebaseline) {
+        fprintf(stderr, "usage: %s [-r] name\n", argv[0]);
+        return 2;
+    }
+    const char* name = argv[argc - 1];
+    snprintf(command, sizeof(command), "./%s", name);
+    snprintf(output, sizeof(output), "%s.png", name);
+    snprintf(reference, sizeof(reference), REFERENCE_DIR "%s.png", name);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = system(command);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    if (status != 0) {
+        printf("%-18s FAILED: exit status %d\n", name, status);
+        return 1;
+    }
+    if (!readPNG(output, &a) || !readPNG(reference, &b) || a.w != b.w || a.h != b.h) {
+        printf("%-18s FAILED: cannot compare %s with %s\n", name, output, reference);
+        return 1;
+    }
+
+    if (rebaseline && !record(name, seconds)) {
+        printf("%-18s FAILED: cannot write " REFERENCE_DIR "timings\n", name);
+        return 1;
+    }
+
+    double sum = 0.0, blockSum = 0.0, minPSNR = lookup("thresholds", name), base = rebaseline ? seconds : lookup("timings", name);
+    for (size_t i = 0; i < (size_t)a.w * a.h * 3; i++)
+        sum += (double)(a.rgb[i] - b.rgb[i]) * (a.rgb[i] - b.rgb[i]);
+    for (unsigned y = 0; y + BLOCK <= a.h; y += BLOCK)
+        for (unsigned x = 0; x + BLOCK <= a.w; x += BLOCK)
+            for (int c = 0; c < 3; c++) {
+                double d = 0.0;
+                for (int j = 0; j < BLOCK; j++)
+                    for (int i = 0; i < BLOCK; i++)
+                        d += a.rgb[((y + j) * a.w + x + i) * 3 + c] - b.rgb[((y + j) * b.w + x + i) * 3 + c];
+                blockSum += d * d / (BLOCK * BLOCK * BLOCK * BLOCK);
+            }
+    double rmse = sqrt(sum / ((size_t)a.w * a.h * 3));
+    double blockRMSE = sqrt(blockSum / ((a.w / BLOCK) * (a.h / BLOCK) * 3));
+    double psnr = blockRMSE > 0.0 ? 20.0 * log10(255.0 / blockRMSE) : 99.0;
+    double maxSeconds = base * TIME_TOLERANCE + TIME_SLACK;
+    int ok = minPSNR >= 0.0 && psnr >= minPSNR; // A check without threshold fails
+    int fast = base >= 0.0 && seconds <= maxSeconds; // So does a check without reference time
+    printf("%-18s rmse %6.2f  psnr %5.2f dB (min %5.2f)  time %6.2fs (max %6.2fs)  %s\n",
+        name, rmse, psnr, minPSNR, seconds, maxSeconds, ok && fast ? "ok" : ok ? "FAILED: slow" : "FAILED");
+    free(a.rgb);
+    free(b.rgb);
+    return ok && fast ? 0 : 1;
+}
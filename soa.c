@@ -0,0 +1,266 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 5
+#define MAX_PRIMITIVE 64
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+typedef struct { float reflectivity, eta; Color emissive, absorption; } Material;
+
+// Primitives of each type stored as struct of arrays, materials referenced by index
+typedef struct { int n; float cx[MAX_PRIMITIVE], cy[MAX_PRIMITIVE], r[MAX_PRIMITIVE]; int material[MAX_PRIMITIVE]; } Circles;
+typedef struct { int n; float cx[MAX_PRIMITIVE], cy[MAX_PRIMITIVE], costheta[MAX_PRIMITIVE], sintheta[MAX_PRIMITIVE], sx[MAX_PRIMITIVE], sy[MAX_PRIMITIVE]; int material[MAX_PRIMITIVE]; } Boxes;
+
+// The same primitives as arrays of structs, each with a copy of its material
+typedef struct { float cx, cy, r; Material material; } Circle;
+typedef struct { float cx, cy, costheta, sintheta, sx, sy; Material material; } Box;
+
+unsigned char img[W * H * 3];
+Material materials[] = {
+    { 0.0f, 0.0f, { 10.0f, 10.0f, 10.0f }, BLACK },
+    { 0.0f, 1.5f, BLACK, { 4.0f, 4.0f, 1.0f } },
+    { 0.0f, 1.5f, BLACK, { 1.0f, 4.0f, 4.0f } },
+    { 0.0f, 1.5f, BLACK, { 4.0f, 1.0f, 4.0f } },
+    { 0.0f, 1.5f, BLACK, { 1.0f, 1.0f, 4.0f } },
+    { 0.0f, 1.5f, BLACK, { 4.0f, 1.0f, 1.0f } },
+};
+Circles circles;
+Boxes boxes;
+Circle circleArray[MAX_PRIMITIVE];
+Box boxArray[MAX_PRIMITIVE];
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+// Takes the rotation as cosine and sine, precomputed like those of Boxes
+float boxSDF(float x, float y, float cx, float cy, float costheta, float sintheta, float sx, float sy) {
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+void addCircle(float cx, float cy, float r, int material) {
+    int i = circles.n++;
+    circles.cx[i] = cx;
+    circles.cy[i] = cy;
+    circles.r[i] = r;
+    circles.material[i] = material;
+    Circle c = { cx, cy, r, materials[material] };
+    circleArray[i] = c;
+}
+
+void addBox(float cx, float cy, float theta, float sx, float sy, int material) {
+    int i = boxes.n++;
+    boxes.cx[i] = cx;
+    boxes.cy[i] = cy;
+    boxes.costheta[i] = cosf(theta);
+    boxes.sintheta[i] = sinf(theta);
+    boxes.sx[i] = sx;
+    boxes.sy[i] = sy;
+    boxes.material[i] = material;
+    Box b = { cx, cy, boxes.costheta[i], boxes.sintheta[i], sx, sy, materials[material] };
+    boxArray[i] = b;
+}
+
+void load() {
+    addCircle(0.5f, -0.2f, 0.1f, 0);
+    for (int j = 0; j < 3; j++)
+        for (int i = 0; i < 3; i++)
+            if ((i + j) & 1)
+                addBox(0.25f + i * 0.25f, 0.3f + j * 0.25f, TWO_PI / 16.0f * (i + j), 0.07f, 0.05f, 1 + (i + 2 * j) % 5);
+            else
+                addCircle(0.25f + i * 0.25f, 0.3f + j * 0.25f, 0.08f, 1 + (i + 2 * j) % 5);
+}
+
+// The same scene in the usual array-of-structs form, for comparison. It does
+// the same arithmetic as sceneDistance(), so the timing differs by layout only.
+Result scene(float x, float y) {
+    Result r = { MAX_DISTANCE, 0.0f, 0.0f, BLACK, BLACK };
+    for (int i = 0; i < circles.n; i++) {
+        const Circle* p = &circleArray[i];
+        const Material* m = &p->material;
+        Result c = { circleSDF(x, y, p->cx, p->cy, p->r), m->reflectivity, m->eta, m->emissive, m->absorption };
+        r = unionOp(r, c);
+    }
+    for (int i = 0; i < boxes.n; i++) {
+        const Box* p = &boxArray[i];
+        const Material* m = &p->material;
+        Result b = { boxSDF(x, y, p->cx, p->cy, p->costheta, p->sintheta, p->sx, p->sy), m->reflectivity, m->eta, m->emissive, m->absorption };
+        r = unionOp(r, b);
+    }
+    return r;
+}
+
+// Distances of each type are computed in a branch-free loop over contiguous
+// arrays, then reduced. Only the index of the winning material is returned.
+float sceneDistance(float x, float y, int* material) {
+    float d[MAX_PRIMITIVE], sd = MAX_DISTANCE;
+    *material = -1;
+    for (int i = 0; i < circles.n; i++) {
+        float ux = x - circles.cx[i], uy = y - circles.cy[i];
+        d[i] = sqrtf(ux * ux + uy * uy) - circles.r[i];
+    }
+    for (int i = 0; i < circles.n; i++)
+        if (d[i] < sd) {
+            sd = d[i];
+            *material = circles.material[i];
+        }
+    for (int i = 0; i < boxes.n; i++) {
+        float ux = x - boxes.cx[i], uy = y - boxes.cy[i];
+        float dx = fabsf(ux * boxes.costheta[i] + uy * boxes.sintheta[i]) - boxes.sx[i];
+        float dy = fabsf(uy * boxes.costheta[i] - ux * boxes.sintheta[i]) - boxes.sy[i];
+        float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+        d[i] = fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+    }
+    for (int i = 0; i < boxes.n; i++)
+        if (d[i] < sd) {
+            sd = d[i];
+            *material = boxes.material[i];
+        }
+    return sd;
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    int m;
+    *nx = (sceneDistance(x + EPSILON, y, &m) - sceneDistance(x - EPSILON, y, &m)) * (0.5f / EPSILON);
+    *ny = (sceneDistance(x, y + EPSILON, &m) - sceneDistance(x, y - EPSILON, &m)) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    int id;
+    float t = 1e-3f;
+    float sign = sceneDistance(ox, oy, &id) > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        float sd = sceneDistance(x, y, &id);
+        if (sd * sign < EPSILON) {
+            const Material* r = &materials[id];
+            Color sum = r->emissive;
+            if (depth < MAX_DEPTH && r->eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r->reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r->eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r->eta : 1.0f / r->eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r->eta, 1.0f) : fresnel(cosi, cost, 1.0f, r->eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            return colorMultiply(sum, beerLambert(r->absorption, t));
+        }
+        t += sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+Color sample(float x, float y) {
+    Color sum = BLACK;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum = colorAdd(sum, trace(x, y, cosf(a), sinf(a), 0));
+    }
+    return colorScale(sum, 1.0f / N);
+}
+
+// Time distance queries of both layouts over the image
+void compare() {
+    float sum[2] = { 0.0f, 0.0f };
+    for (int k = 0; k < 2; k++) {
+        clock_t start = clock();
+        for (int y = 0; y < H * 16; y++)
+            for (int x = 0; x < W; x++) {
+                int m;
+                sum[k] += k ? sceneDistance((float)x / W, (float)(y % H) / H, &m) : scene((float)x / W, (float)(y % H) / H).sd;
+            }
+        printf("%-16s %.3fs (checksum %f)\n", k ? "struct of arrays" : "array of structs", (double)(clock() - start) / CLOCKS_PER_SEC, sum[k]);
+    }
+}
+
+int main() {
+    load();
+    compare();
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            Color c = sample((float)x / W, (float)y / H);
+            p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+            p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+            p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+        }
+    svpng(fopen("soa.png", "wb"), W, H, img, 0);
+}
@@ -0,0 +1,281 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), expf()
+#include <stdlib.h> // rand(), RAND_MAX, srand(), atoi()
+#include <time.h> // clock(), CLOCKS_PER_SEC
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 5
+#define MAX_MATERIAL 4
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+// Features of materials, a kernel handles the features in its mask
+#define FEATURE_REFLECT 1
+#define FEATURE_REFRACT 2
+#define FEATURE_ABSORB 4
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd; int material; } Result;
+typedef struct { float reflectivity, eta; Color emissive, absorption; } Material;
+typedef struct { const char* name; Result (*sdf)(float x, float y); int n; Material materials[MAX_MATERIAL]; } Scene;
+typedef Color (*Kernel)(float ox, float oy, float dx, float dy, int depth);
+
+unsigned char img[W * H * 3];
+const Scene* current;
+Kernel trace;
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result subtractOp(Result a, Result b) {
+    Result r = a;
+    r.sd = (a.sd > -b.sd) ? a.sd : -b.sd;
+    return r;
+}
+
+// Scenes of the basic, reflection, fresnel and beerlambert_color samples,
+// each referencing materials of its own table by index
+Result emissionScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, 0.5f, 0.1f), 0 };
+    return a;
+}
+
+Result reflectScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.4f, 0.2f, 0.1f), 0 };
+    Result d = {  planeSDF(x, y, 0.0f, 0.5f, 0.0f, -1.0f), 1 };
+    Result e = { circleSDF(x, y, 0.5f, 0.5f, 0.4f), 1 };
+    return unionOp(a, subtractOp(d, e));
+}
+
+Result dielectricScene(float x, float y) {
+    Result c = { circleSDF(x, y, 0.5f, -0.5f, 0.05f), 0 };
+    Result d = { circleSDF(x, y, 0.5f, 0.2f, 0.35f), 1 };
+    Result e = { circleSDF(x, y, 0.5f, 0.8f, 0.35f), 1 };
+    return unionOp(c, intersectOp(d, e));
+}
+
+Result absorbScene(float x, float y) {
+    Result a = { circleSDF(x, y, 0.5f, -0.2f, 0.1f), 0 };
+    Result b = {   ngonSDF(x, y, 0.5f, 0.5f, 0.25f, 5.0f), 1 };
+    return unionOp(a, b);
+}
+
+const Scene scenes[] = {
+    { "emission", emissionScene, 1, { { 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK } } },
+    { "reflect", reflectScene, 2, { { 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK }, { 0.9f, 0.0f, BLACK, BLACK } } },
+    { "dielectric", dielectricScene, 2, { { 0.0f, 0.0f, { 20.0f, 20.0f, 20.0f }, BLACK }, { 0.2f, 1.5f, BLACK, BLACK } } },
+    { "absorb", absorbScene, 2, { { 0.0f, 0.0f, { 10.0f, 10.0f, 10.0f }, BLACK }, { 0.0f, 1.5f, BLACK, { 4.0f, 4.0f, 1.0f } } } },
+};
+
+Result scene(float x, float y) {
+    return current->sdf(x, y);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+// The tracer of beerlambert_color.c with the features as a constant mask. Each
+// instance recurses into itself, and the compiler folds away the branches and
+// math of features outside its mask: an emission only kernel never computes
+// a gradient, and a kernel without absorption skips the three expf() calls.
+#define TRACE(name, features) \
+Color name(float ox, float oy, float dx, float dy, int depth) { \
+    float t = 1e-3f; \
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f; \
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) { \
+        float x = ox + dx * t, y = oy + dy * t; \
+        Result r = scene(x, y); \
+        if (r.sd * sign < EPSILON) { \
+            const Material* m = &current->materials[r.material]; \
+            Color sum = m->emissive; \
+            if (((features) & (FEATURE_REFLECT | FEATURE_REFRACT)) && depth < MAX_DEPTH && (m->reflectivity > 0.0f || m->eta > 0.0f)) { \
+                float nx, ny, rx, ry, refl = m->reflectivity; \
+                gradient(x, y, &nx, &ny); \
+                float s = 1.0f / (nx * nx + ny * ny); \
+                nx *= sign * s; \
+                ny *= sign * s; \
+                if (((features) & FEATURE_REFRACT) && m->eta > 0.0f) { \
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? m->eta : 1.0f / m->eta, &rx, &ry)) { \
+                        float cosi = -(dx * nx + dy * ny); \
+                        float cost = -(rx * nx + ry * ny); \
+                        refl = sign < 0.0f ? fresnel(cosi, cost, m->eta, 1.0f) : fresnel(cosi, cost, 1.0f, m->eta); \
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f); \
+                        sum = colorAdd(sum, colorScale(name(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl)); \
+                    } \
+                    else \
+                        refl = 1.0f; /* Total internal reflection */ \
+                } \
+                if (refl > 0.0f) { \
+                    reflect(dx, dy, nx, ny, &rx, &ry); \
+                    sum = colorAdd(sum, colorScale(name(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl)); \
+                } \
+            } \
+            return ((features) & FEATURE_ABSORB) ? colorMultiply(sum, beerLambert(m->absorption, t)) : sum; \
+        } \
+        t += r.sd * sign; \
+    } \
+    Color black = BLACK; \
+    return black; \
+}
+
+TRACE(trace0, 0)
+TRACE(trace1, 1)
+TRACE(trace2, 2)
+TRACE(trace3, 3)
+TRACE(trace4, 4)
+TRACE(trace5, 5)
+TRACE(trace6, 6)
+TRACE(trace7, 7)
+
+// Indexed by feature mask, the last one is the general tracer
+const Kernel kernels[] = { trace0, trace1, trace2, trace3, trace4, trace5, trace6, trace7 };
+
+// Features of the materials a scene references, scanned once at load
+int features(const Scene* s) {
+    int f = 0;
+    for (int i = 0; i < s->n; i++) {
+        const Material* m = &s->materials[i];
+        if (m->reflectivity > 0.0f)
+            f |= FEATURE_REFLECT;
+        if (m->eta > 0.0f)
+            f |= FEATURE_REFRACT;
+        if (m->absorption.r > 0.0f || m->absorption.g > 0.0f || m->absorption.b > 0.0f)
+            f |= FEATURE_ABSORB;
+    }
+    return f;
+}
+
+void load(int index) {
+    current = &scenes[index];
+    trace = kernels[features(current)];
+}
+
+Color sample(float x, float y) {
+    Color sum = BLACK;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum = colorAdd(sum, trace(x, y, cosf(a), sinf(a), 0));
+    }
+    return colorScale(sum, 1.0f / N);
+}
+
+// Time the general and the specialized kernel on every fourth row and column
+// of each scene. Both draw the same random numbers, so the sums must match.
+void compare() {
+    for (int k = 0; k < (int)(sizeof(scenes) / sizeof(scenes[0])); k++) {
+        double seconds[2];
+        float sum[2] = { 0.0f, 0.0f };
+        load(k);
+        Kernel specialized = trace;
+        for (int j = 0; j < 2; j++) {
+            trace = j ? specialized : kernels[FEATURE_REFLECT | FEATURE_REFRACT | FEATURE_ABSORB];
+            srand(k);
+            clock_t start = clock();
+            for (int y = 0; y < H; y += 4)
+                for (int x = 0; x < W; x += 4) {
+                    Color c = sample((float)x / W, (float)y / H);
+                    sum[j] += c.r + c.g + c.b;
+                }
+            seconds[j] = (double)(clock() - start) / CLOCKS_PER_SEC;
+        }
+        printf("%-10s features %d  general %.3fs  specialized %.3fs  %.2fx  (checksum %f %s)\n", current->name, features(current),
+            seconds[0], seconds[1], seconds[0] / seconds[1], sum[1], sum[0] == sum[1] ? "match" : "MISMATCH");
+    }
+}
+
+// Usage: ./specialize [scene], the scene index defaults to the absorbing one
+int main(int argc, char* argv[]) {
+    int index = argc > 1 ? atoi(argv[1]) : 3;
+    if (index < 0 || index >= (int)(sizeof(scenes) / sizeof(scenes[0])))
+        index = 3;
+    compare();
+    load(index);
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            Color c = sample((float)x / W, (float)y / H);
+            p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+            p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+            p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+        }
+    svpng(fopen("specialize.png", "wb"), W, H, img, 0);
+}
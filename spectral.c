@@ -0,0 +1,228 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt(), expf()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define LANES 4                 // Wavelengths carried by each path
+#define LAMBDA_MIN 380.0f
+#define LAMBDA_MAX 720.0f
+
+typedef struct { float v[LANES]; } Spectrum;
+
+// Spectrally flat emission. eta is the refractive index at the sodium D line,
+// dispersion the Cauchy coefficient B in um^2. Absorption is flat, or only
+// outside a pass band of 50nm around pass if it is not zero.
+typedef struct { float sd, emissive, reflectivity, eta, dispersion, absorption, pass; } Result;
+
+unsigned char img[W * H * 3];
+float white[3];
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float segmentSDF(float x, float y, float ax, float ay, float bx, float by) {
+    float vx = x - ax, vy = y - ay, ux = bx - ax, uy = by - ay;
+    float t = fmaxf(fminf((vx * ux + vy * uy) / (ux * ux + uy * uy), 1.0f), 0.0f);
+    float dx = vx - ux * t, dy = vy - uy * t;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+float boxSDF(float x, float y, float cx, float cy, float theta, float sx, float sy) {
+    float costheta = cosf(theta), sintheta = sinf(theta);
+    float dx = fabs((x - cx) * costheta + (y - cy) * sintheta) - sx;
+    float dy = fabs((y - cy) * costheta - (x - cx) * sintheta) - sy;
+    float ax = fmaxf(dx, 0.0f), ay = fmaxf(dy, 0.0f);
+    return fminf(fmaxf(dx, dy), 0.0f) + sqrtf(ax * ax + ay * ay);
+}
+
+float triangleSDF(float x, float y, float ax, float ay, float bx, float by, float cx, float cy) {
+    float d = fminf(fminf(
+        segmentSDF(x, y, ax, ay, bx, by),
+        segmentSDF(x, y, bx, by, cx, cy)),
+        segmentSDF(x, y, cx, cy, ax, ay));
+    return (bx - ax) * (y - ay) > (by - ay) * (x - ax) && 
+           (cx - bx) * (y - by) > (cy - by) * (x - bx) && 
+           (ax - cx) * (y - cy) > (ay - cy) * (x - cx) ? -d : d;
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+// A white light collimated by two slits onto a dispersive prism
+Result scene(float x, float y) {
+    Result a = { circleSDF(x, y, -0.2f, 0.4f, 0.15f), 40.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    Result b = { fminf(boxSDF(x, y, 0.05f, 0.19f, 0.0f, 0.01f, 0.19f), boxSDF(x, y, 0.05f, 0.71f, 0.0f, 0.01f, 0.3f)), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    Result c = { fminf(boxSDF(x, y, 0.3f, 0.19f, 0.0f, 0.01f, 0.19f), boxSDF(x, y, 0.3f, 0.71f, 0.0f, 0.01f, 0.3f)), 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    Result d = { triangleSDF(x, y, 0.55f, 0.25f, 0.7f, 0.51f, 0.4f, 0.51f), 0.0f, 0.0f, 1.5f, 0.05f, 0.0f, 0.0f };
+    // Result d = { triangleSDF(x, y, 0.55f, 0.25f, 0.7f, 0.51f, 0.4f, 0.51f), 0.0f, 0.0f, 1.5f, 0.05f, 4.0f, 550.0f };
+    return unionOp(unionOp(a, b), unionOp(c, d));
+}
+
+// Cauchy's equation, offset so that eta is the index at 589.3nm
+float refractiveIndex(Result r, float lambda) {
+    float l = lambda * 1e-3f;
+    return r.eta + r.dispersion * (1.0f / (l * l) - 1.0f / (0.5893f * 0.5893f));
+}
+
+float absorptionCoefficient(Result r, float lambda) {
+    if (r.pass <= 0.0f)
+        return r.absorption;
+    float u = (lambda - r.pass) / 50.0f;
+    return r.absorption * (1.0f - expf(-u * u));
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+// Radiance of the first lanes wavelengths of lambda, the others are zero.
+// Lane 0 is the hero wavelength. A dispersive refraction sends each wavelength
+// to a different direction, so only the hero continues, weighted by LANES.
+// Reflection keeps all lanes, each with its own Fresnel reflectance.
+Spectrum trace(float ox, float oy, float dx, float dy, int depth, const float* lambda, int lanes) {
+    Spectrum sum = { { 0.0f } };
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            for (int j = 0; j < lanes; j++)
+                sum.v[j] = r.emissive;
+            if (depth < MAX_DEPTH && (r.reflectivity > 0.0f || r.eta > 0.0f)) {
+                float nx, ny, rx, ry, refl[LANES];
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                for (int j = 0; j < lanes; j++)
+                    refl[j] = r.reflectivity;
+                if (r.eta > 0.0f) {
+                    int transmit = 0;
+                    for (int j = lanes - 1; j >= 0; j--) { // Ends with the direction of the hero
+                        float eta = refractiveIndex(r, lambda[j]);
+                        if (refract(dx, dy, nx, ny, sign < 0.0f ? eta : 1.0f / eta, &rx, &ry)) {
+                            float cosi = -(dx * nx + dy * ny);
+                            float cost = -(rx * nx + ry * ny);
+                            refl[j] = sign < 0.0f ? fresnel(cosi, cost, eta, 1.0f) : fresnel(cosi, cost, 1.0f, eta);
+                            refl[j] = fmaxf(fminf(refl[j], 1.0f), 0.0f);
+                            transmit |= j == 0;
+                        }
+                        else
+                            refl[j] = 1.0f; // Total internal reflection
+                    }
+                    if (transmit) {
+                        if (r.dispersion != 0.0f && lanes > 1) {
+                            Spectrum c = trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1, lambda, 1);
+                            sum.v[0] += (1.0f - refl[0]) * LANES * c.v[0];
+                        }
+                        else {
+                            Spectrum c = trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1, lambda, lanes);
+                            for (int j = 0; j < lanes; j++)
+                                sum.v[j] += (1.0f - refl[j]) * c.v[j];
+                        }
+                    }
+                }
+                reflect(dx, dy, nx, ny, &rx, &ry);
+                Spectrum c = trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1, lambda, lanes);
+                for (int j = 0; j < lanes; j++)
+                    sum.v[j] += refl[j] * c.v[j];
+            }
+            for (int j = 0; j < lanes; j++)
+                sum.v[j] *= expf(-absorptionCoefficient(r, lambda[j]) * t);
+            return sum;
+        }
+        t += r.sd * sign;
+    }
+    return sum;
+}
+
+float lobe(float x, float mu, float sigma1, float sigma2) {
+    float u = (x - mu) / (x < mu ? sigma1 : sigma2);
+    return expf(-0.5f * u * u);
+}
+
+// Analytic fit of the CIE 1931 color matching functions (Wyman et al. 2013), to linear sRGB
+void spectrumToRGB(float lambda, float* rgb) {
+    float x = 1.056f * lobe(lambda, 599.8f, 37.9f, 31.0f) + 0.362f * lobe(lambda, 442.0f, 16.0f, 26.7f) - 0.065f * lobe(lambda, 501.1f, 20.4f, 26.2f);
+    float y = 0.821f * lobe(lambda, 568.8f, 46.9f, 40.5f) + 0.286f * lobe(lambda, 530.9f, 16.3f, 31.1f);
+    float z = 1.217f * lobe(lambda, 437.0f, 11.8f, 36.0f) + 0.681f * lobe(lambda, 459.0f, 26.0f, 13.8f);
+    rgb[0] =  3.2406f * x - 1.5372f * y - 0.4986f * z;
+    rgb[1] = -0.9689f * x + 1.8758f * y + 0.0415f * z;
+    rgb[2] =  0.0557f * x - 0.2040f * y + 1.0570f * z;
+}
+
+// Each sample draws a hero wavelength, the other lanes are evenly rotated from it
+void sample(float x, float y, float* rgb) {
+    float range = LAMBDA_MAX - LAMBDA_MIN;
+    rgb[0] = rgb[1] = rgb[2] = 0.0f;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N, lambda[LANES], c[3];
+        float hero = range * rand() / RAND_MAX;
+        for (int j = 0; j < LANES; j++)
+            lambda[j] = LAMBDA_MIN + fmodf(hero + range * j / LANES, range);
+        Spectrum s = trace(x, y, cosf(a), sinf(a), 0, lambda, LANES);
+        for (int j = 0; j < LANES; j++) {
+            spectrumToRGB(lambda[j], c);
+            for (int k = 0; k < 3; k++)
+                rgb[k] += s.v[j] * c[k];
+        }
+    }
+    for (int k = 0; k < 3; k++)
+        rgb[k] /= white[k] * N * LANES;
+}
+
+int main() {
+    // Average color of a flat spectrum, so that it maps to white
+    for (int i = 0; i < 1000; i++) {
+        float c[3];
+        spectrumToRGB(LAMBDA_MIN + (LAMBDA_MAX - LAMBDA_MIN) * (i + 0.5f) / 1000, c);
+        for (int k = 0; k < 3; k++)
+            white[k] += c[k] / 1000;
+    }
+
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            float c[3];
+            sample((float)x / W, (float)y / H, c);
+            for (int k = 0; k < 3; k++)
+                p[k] = (int)(fmaxf(fminf(c[k] * 255.0f, 255.0f), 0.0f));
+        }
+    svpng(fopen("spectral.png", "wb"), W, H, img, 0);
+}
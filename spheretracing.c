@@ -0,0 +1,251 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), sinf(), cosf(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 512
+#define H 512
+#define N 64
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define OMEGA 1.2f              // Over-relaxation factor of the step, 1 for plain sphere tracing
+#define HIT_EPSILON 1e-4f       // Hit threshold before refinement
+#define GRAZE_EPSILON 1e-4f     // Closest approach accepted as a hit when the step budget runs out
+#define REFINE_STEP 4
+#define LIPSCHITZ_STEP 1e-3f    // Spacing of the finite differences that measure the Lipschitz bound
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+
+unsigned char img[W * H * 3];
+long long rayCount, stepCount, budgetCount;
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(float x, float y, float cx, float cy, float r, float n) {
+    float ux = x - cx, uy = y - cy, a = TWO_PI / n;
+    float t = fmodf(atan2f(uy, ux) + TWO_PI, a), s = sqrtf(ux * ux + uy * uy);
+    return planeSDF(s * cosf(t), s * sinf(t), r, 0.0f, cosf(a * 0.5f), sinf(a * 0.5f));
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+// The heart of heart.c with the lights moved onto the bisectors of their
+// sectors. Every folded distance is then mirror symmetric across the seams,
+// so it is continuous there with gradients of length 1 on either side: the
+// folded circle is the exact distance to the nearest light, and the folded
+// edge line is the distance to the n-gon edges, a lower bound. The scene is
+// 1-Lipschitz, which over-relaxed steps rely on to detect overshooting.
+Result scene(float x, float y) {
+    float u = x - 0.5f, v = y - 0.5f, t = fmodf(atan2f(v, u) + TWO_PI, TWO_PI / 16), s = sqrtf(u * u + v * v);
+    x = fabsf(x - 0.5f) + 0.5f;
+    Color m = { 0.0f, 3.0f, 3.0f };
+    Result a = { ngonSDF(x, y, 0.7f, 0.35f, 0.2f, 16), 0.0f, 1.77f, BLACK, m };
+    Result b = { ngonSDF(x, y, 0.35f, 0.35f, 0.55f, 32), 0.0f, 1.77f, BLACK, m };
+    Result c = {  planeSDF(x, y, 0.5f, 0.35f, 0.0f, -1.0f), 0.0f, 1.77f, BLACK, m };
+    Result d = { circleSDF(s * cosf(t), s * sinf(t), 0.6f * cosf(TWO_PI / 32), 0.6f * sinf(TWO_PI / 32), 0.05f), 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK };
+    return unionOp(unionOp(a, intersectOp(b, c)), d);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+// Over-relaxed sphere tracing (Keinert et al. 2014). A step of omega times the
+// radius is taken back when the unbounding spheres of two consecutive points
+// do not overlap, after which plain sphere tracing continues. Hits are refined
+// by plain steps, and when the step budget runs out the closest approach is
+// taken as a hit if it is within GRAZE_EPSILON.
+int march(float ox, float oy, float dx, float dy, float sign, float omega, float graze, float* tHit) {
+    float t = 1e-3f, step = 0.0f, prevRadius = 0.0f, prevSigned = 0.0f, prevT = 0.0f, bestRadius = MAX_DISTANCE, bestT = t;
+    int i;
+    rayCount++;
+    for (i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float signedRadius = scene(ox + dx * t, oy + dy * t).sd * sign, radius = fabsf(signedRadius);
+        stepCount++;
+        if (omega > 1.0f && (signedRadius < 0.0f || radius + prevRadius < step)) {
+            step -= omega * step;
+            omega = 1.0f;
+        }
+        else {
+            if (signedRadius < (graze > 0.0f ? HIT_EPSILON : EPSILON)) {
+                // Secant iterations on the last two points, plain steps if the distance is not decreasing
+                for (int j = 0; j < REFINE_STEP && graze > 0.0f && fabsf(signedRadius) > EPSILON; j++, stepCount++) {
+                    float slope = (prevSigned - signedRadius) / (t - prevT), next = slope > 0.0f ? t + signedRadius / slope : t + signedRadius;
+                    prevT = t;
+                    prevSigned = signedRadius;
+                    t = next;
+                    signedRadius = scene(ox + dx * t, oy + dy * t).sd * sign;
+                }
+                *tHit = t;
+                return 1;
+            }
+            if (radius < bestRadius) {
+                bestRadius = radius;
+                bestT = t;
+            }
+            step = signedRadius * omega;
+        }
+        prevRadius = radius;
+        prevSigned = signedRadius;
+        prevT = t;
+        t += step;
+    }
+    if (i == MAX_STEP) {
+        budgetCount++;
+        if (bestRadius < graze) {
+            *tHit = bestT;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t, sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    if (march(ox, oy, dx, dy, sign, OMEGA, GRAZE_EPSILON, &t)) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        Color sum = r.emissive;
+        if (depth < MAX_DEPTH && r.eta > 0.0f) {
+            float nx, ny, rx, ry, refl = r.reflectivity;
+            gradient(x, y, &nx, &ny);
+            float s = 1.0f / (nx * nx + ny * ny);
+            nx *= sign * s;
+            ny *= sign * s;
+            if (r.eta > 0.0f) {
+                if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                    float cosi = -(dx * nx + dy * ny);
+                    float cost = -(rx * nx + ry * ny);
+                    refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                    refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                    sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                }
+                else
+                    refl = 1.0f; // Total internal reflection
+            }
+            if (refl > 0.0f) {
+                reflect(dx, dy, nx, ny, &rx, &ry);
+                sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+            }
+        }
+        Color c = colorMultiply(sum, beerLambert(r.absorption, t));
+        return c;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+Color sample(float x, float y) {
+    Color sum = BLACK;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum = colorAdd(sum, trace(x, y, cosf(a), sinf(a), 0));
+    }
+    return colorScale(sum, 1.0f / N);
+}
+
+// Largest slope of the distance between neighboring points of a grid, which
+// must not exceed 1 for the steps to be safe
+float lipschitz() {
+    float l = 0.0f;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            float px = (x + 0.5f) / W, py = (y + 0.5f) / H, d = scene(px, py).sd;
+            l = fmaxf(l, fabsf(scene(px + LIPSCHITZ_STEP, py).sd - d) / LIPSCHITZ_STEP);
+            l = fmaxf(l, fabsf(scene(px, py + LIPSCHITZ_STEP).sd - d) / LIPSCHITZ_STEP);
+        }
+    return l;
+}
+
+// Compare plain and enhanced marching on the primary rays of a subset of pixels
+void statistics(float omega, float graze, const char* name) {
+    int hits = 0;
+    rayCount = stepCount = budgetCount = 0;
+    for (int y = 0; y < H; y += 16)
+        for (int x = 0; x < W; x += 16)
+            for (int i = 0; i < N; i++) {
+                float a = TWO_PI * (i + 0.5f) / N, ox = (float)x / W, oy = (float)y / H, t;
+                hits += march(ox, oy, cosf(a), sinf(a), scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f, omega, graze, &t);
+            }
+    printf("%-8s %6.2f steps/ray, %5.2f%% hits, %5.2f%% out of budget\n", name,
+        (double)stepCount / rayCount, 100.0 * hits / rayCount, 100.0 * budgetCount / rayCount);
+}
+
+int main() {
+    printf("lipschitz %4.2f\n", lipschitz());
+    statistics(1.0f, 0.0f, "plain");
+    statistics(OMEGA, GRAZE_EPSILON, "enhanced");
+    rayCount = stepCount = budgetCount = 0;
+    unsigned char* p = img;
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++, p += 3) {
+            Color c = sample((float)x / W, (float)y / H);
+            p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+            p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+            p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+        }
+    printf("render   %6.2f steps/ray, %5.2f%% out of budget\n", (double)stepCount / rayCount, 100.0 * budgetCount / rayCount);
+    svpng(fopen("spheretracing.png", "wb"), W, H, img, 0);
+}
@@ -0,0 +1,253 @@
+#include "svpng.inc"
+#include <math.h> // fabsf(), fminf(), fmaxf(), floorf(), roundf(), sinf(), cosf(), atan2f(), sqrt()
+#include <stdlib.h> // rand(), RAND_MAX
+
+#define TWO_PI 6.28318530718f
+#define W 1024
+#define H 1024
+#define N 256
+#define MAX_STEP 64
+#define MAX_DISTANCE 5.0f
+#define EPSILON 1e-6f
+#define BIAS 1e-4f
+#define MAX_DEPTH 3
+#define MAX_SECTOR 64
+#define SYMMETRY_CHECK 256      // Grid of points at which a declared mirror plane is verified
+#define SYMMETRY_TOLERANCE 1e-4f
+#define BLACK { 0.0f, 0.0f, 0.0f }
+
+typedef struct { float r, g, b; } Color;
+typedef struct { float sd, reflectivity, eta; Color emissive, absorption; } Result;
+typedef struct { int n; float a, bc, bs, c[MAX_SECTOR], s[MAX_SECTOR]; } Polar; // bc, bs: sector bisector
+typedef struct { int x, y; } Symmetry;
+
+unsigned char img[W * H * 3];
+Polar ring, lobe, body;
+
+// Mirror planes of the whole scene through the image center, so that only
+// the fundamental domain needs to be rendered
+Symmetry symmetry = { 1, 0 };
+
+Color colorAdd(Color a, Color b) {
+    Color c = { a.r + b.r, a.g + b.g, a.b + b.b };
+    return c;
+}
+
+Color colorMultiply(Color a, Color b) {
+    Color c = { a.r * b.r, a.g * b.g, a.b * b.b };
+    return c;
+}
+
+Color colorScale(Color a, float s) {
+    Color c = { a.r * s, a.g * s, a.b * s };
+    return c;
+}
+
+// Fold space onto the side x >= cx (or y >= cy)
+void mirrorX(float* x, float cx) {
+    *x = fabsf(*x - cx) + cx;
+}
+
+void mirrorY(float* y, float cy) {
+    *y = fabsf(*y - cy) + cy;
+}
+
+// Rotations of the n sectors are tabulated once, so folding costs one
+// atan2f() instead of atan2f(), fmodf(), sqrtf(), cosf() and sinf()
+void polarInit(Polar* p, int n) {
+    p->n = n;
+    p->a = TWO_PI / n;
+    p->bc = cosf(p->a * 0.5f);
+    p->bs = sinf(p->a * 0.5f);
+    for (int k = 0; k < n; k++) {
+        p->c[k] = cosf(p->a * k);
+        p->s[k] = sinf(p->a * k);
+    }
+}
+
+// Rotate (x, y), relative to the center of repetition, into the sector [0, 2 pi / n)
+void polarRepeat(const Polar* p, float* x, float* y) {
+    int k = (int)floorf((atan2f(*y, *x) + TWO_PI) / p->a) % p->n;
+    float u = *x * p->c[k] + *y * p->s[k], v = *y * p->c[k] - *x * p->s[k];
+    *x = u;
+    *y = v;
+}
+
+// Map (x, y) into the local frame of the nearest cell of an nx by ny grid
+// with spacing (px, py) centered at (cx, cy)
+void gridRepeat(float* x, float* y, float cx, float cy, float px, float py, int nx, int ny) {
+    float ox = (nx - 1) * 0.5f, oy = (ny - 1) * 0.5f;
+    float i = fminf(fmaxf(roundf((*x - cx) / px + ox), 0.0f), nx - 1.0f);
+    float j = fminf(fmaxf(roundf((*y - cy) / py + oy), 0.0f), ny - 1.0f);
+    *x -= cx + (i - ox) * px;
+    *y -= cy + (j - oy) * py;
+}
+
+float circleSDF(float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    return sqrtf(ux * ux + uy * uy) - r;
+}
+
+float planeSDF(float x, float y, float px, float py, float nx, float ny) {
+    return (x - px) * nx + (y - py) * ny;
+}
+
+float ngonSDF(const Polar* p, float x, float y, float cx, float cy, float r) {
+    float ux = x - cx, uy = y - cy;
+    polarRepeat(p, &ux, &uy);
+    return planeSDF(ux, uy, r, 0.0f, p->bc, p->bs);
+}
+
+Result unionOp(Result a, Result b) {
+    return a.sd < b.sd ? a : b;
+}
+
+Result intersectOp(Result a, Result b) {
+    return a.sd > b.sd ? a : b;
+}
+
+Result scene(float x, float y) {
+    float u = x - 0.5f, v = y - 0.5f;
+    polarRepeat(&ring, &u, &v);
+    mirrorX(&x, 0.5f);
+    Color m = { 0.0f, 3.0f, 3.0f };
+    Result a = { ngonSDF(&lobe, x, y, 0.7f, 0.35f, 0.2f), 0.0f, 1.77f, BLACK, m };
+    Result b = { ngonSDF(&body, x, y, 0.35f, 0.35f, 0.55f), 0.0f, 1.77f, BLACK, m };
+    Result c = {  planeSDF(x, y, 0.5f, 0.35f, 0.0f, -1.0f), 0.0f, 1.77f, BLACK, m };
+    Result d = { circleSDF(u, v, 0.6f * ring.bc, 0.6f * ring.bs, 0.05f), 0.0f, 0.0f, { 2.0f, 2.0f, 2.0f }, BLACK };
+    gridRepeat(&x, &y, 0.5f, 0.5f, 0.9f, 0.9f, 2, 2);
+    Result e = { circleSDF(x, y, 0.0f, 0.0f, 0.03f), 0.0f, 0.0f, { 3.0f, 1.5f, 0.5f }, BLACK };
+    return unionOp(unionOp(unionOp(a, intersectOp(b, c)), d), e);
+}
+
+void gradient(float x, float y, float* nx, float* ny) {
+    *nx = (scene(x + EPSILON, y).sd - scene(x - EPSILON, y).sd) * (0.5f / EPSILON);
+    *ny = (scene(x, y + EPSILON).sd - scene(x, y - EPSILON).sd) * (0.5f / EPSILON);
+}
+
+void reflect(float ix, float iy, float nx, float ny, float* rx, float* ry) {
+    float idotn2 = (ix * nx + iy * ny) * 2.0f;
+    *rx = ix - idotn2 * nx;
+    *ry = iy - idotn2 * ny;
+}
+
+int refract(float ix, float iy, float nx, float ny, float eta, float* rx, float* ry) {
+    float idotn = ix * nx + iy * ny;
+    float k = 1.0f - eta * eta * (1.0f - idotn * idotn);
+    if (k < 0.0f)
+        return 0; // Total internal reflection
+    float a = eta * idotn + sqrtf(k);
+    *rx = eta * ix - a * nx;
+    *ry = eta * iy - a * ny;
+    return 1;
+}
+
+float fresnel(float cosi, float cost, float etai, float etat) {
+    float rs = (etat * cosi - etai * cost) / (etat * cosi + etai * cost);
+    float rp = (etai * cosi - etat * cost) / (etai * cosi + etat * cost);
+    return (rs * rs + rp * rp) * 0.5f;
+}
+
+Color beerLambert(Color a, float d) {
+    Color c = { expf(-a.r * d), expf(-a.g * d), expf(-a.b * d) };
+    return c;
+}
+
+Color trace(float ox, float oy, float dx, float dy, int depth) {
+    float t = 1e-3f;
+    float sign = scene(ox, oy).sd > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < MAX_STEP && t < MAX_DISTANCE; i++) {
+        float x = ox + dx * t, y = oy + dy * t;
+        Result r = scene(x, y);
+        if (r.sd * sign < EPSILON) {
+            Color sum = r.emissive;
+            if (depth < MAX_DEPTH && r.eta > 0.0f) {
+                float nx, ny, rx, ry, refl = r.reflectivity;
+                gradient(x, y, &nx, &ny);
+                float s = 1.0f / (nx * nx + ny * ny);
+                nx *= sign * s;
+                ny *= sign * s;
+                if (r.eta > 0.0f) {
+                    if (refract(dx, dy, nx, ny, sign < 0.0f ? r.eta : 1.0f / r.eta, &rx, &ry)) {
+                        float cosi = -(dx * nx + dy * ny);
+                        float cost = -(rx * nx + ry * ny);
+                        refl = sign < 0.0f ? fresnel(cosi, cost, r.eta, 1.0f) : fresnel(cosi, cost, 1.0f, r.eta);
+                        refl = fmaxf(fminf(refl, 1.0f), 0.0f);
+                        sum = colorAdd(sum, colorScale(trace(x - nx * BIAS, y - ny * BIAS, rx, ry, depth + 1), 1.0f - refl));
+                    }
+                    else
+                        refl = 1.0f; // Total internal reflection
+                }
+                if (refl > 0.0f) {
+                    reflect(dx, dy, nx, ny, &rx, &ry);
+                    sum = colorAdd(sum, colorScale(trace(x + nx * BIAS, y + ny * BIAS, rx, ry, depth + 1), refl));
+                }
+            }
+            Color c = colorMultiply(sum, beerLambert(r.absorption, t));
+            return c;
+        }
+        t += r.sd * sign;
+    }
+    Color black = BLACK;
+    return black;
+}
+
+Color sample(float x, float y) {
+    Color sum = BLACK;
+    for (int i = 0; i < N; i++) {
+        float a = TWO_PI * (i + (float)rand() / RAND_MAX) / N;
+        sum = colorAdd(sum, trace(x, y, cosf(a), sinf(a), 0));
+    }
+    return colorScale(sum, 1.0f / N);
+}
+
+void store(int x, int y, Color c) {
+    unsigned char* p = img + (y * W + x) * 3;
+    p[0] = (int)(fminf(c.r * 255.0f, 255.0f));
+    p[1] = (int)(fminf(c.g * 255.0f, 255.0f));
+    p[2] = (int)(fminf(c.b * 255.0f, 255.0f));
+}
+
+// A declared mirror plane is only trusted if the distance and emission of
+// the scene match at mirrored points, otherwise the full image is rendered
+void checkSymmetry() {
+    float ex = 0.0f, ey = 0.0f;
+    for (int j = 0; j < SYMMETRY_CHECK; j++)
+        for (int i = 0; i < SYMMETRY_CHECK; i++) {
+            float x = (i + 0.5f) / SYMMETRY_CHECK, y = (j + 0.5f) / SYMMETRY_CHECK;
+            Result r = scene(x, y), rx = scene(1.0f - x, y), ry = scene(x, 1.0f - y);
+            ex = fmaxf(ex, fmaxf(fabsf(r.sd - rx.sd), fabsf(r.emissive.r - rx.emissive.r)));
+            ey = fmaxf(ey, fmaxf(fabsf(r.sd - ry.sd), fabsf(r.emissive.r - ry.emissive.r)));
+        }
+    if (symmetry.x && ex > SYMMETRY_TOLERANCE) {
+        printf("scene is not symmetric in x (error %g), mirroring disabled\n", ex);
+        symmetry.x = 0;
+    }
+    if (symmetry.y && ey > SYMMETRY_TOLERANCE) {
+        printf("scene is not symmetric in y (error %g), mirroring disabled\n", ey);
+        symmetry.y = 0;
+    }
+}
+
+int main() {
+    polarInit(&ring, 16);
+    polarInit(&lobe, 16);
+    polarInit(&body, 32);
+    checkSymmetry();
+
+    // Sample pixel centers so that pixel x mirrors exactly onto pixel W - 1 - x
+    int w = symmetry.x ? (W + 1) / 2 : W, h = symmetry.y ? (H + 1) / 2 : H;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++) {
+            Color c = sample((x + 0.5f) / W, (y + 0.5f) / H);
+            store(x, y, c);
+            if (symmetry.x)
+                store(W - 1 - x, y, c);
+            if (symmetry.y)
+                store(x, H - 1 - y, c);
+            if (symmetry.x && symmetry.y)
+                store(W - 1 - x, H - 1 - y, c);
+        }
+    printf("rendered %.1f%% of the pixels\n", 100.0 * w * h / (W * H));
+    svpng(fopen("symmetry.png", "wb"), W, H, img, 0);
+}